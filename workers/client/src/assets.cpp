@@ -0,0 +1,94 @@
+#include "assets.hpp"
+#include "utils.hpp"
+#include <iostream>
+
+using namespace Eigen;
+
+namespace {
+static const std::string kTexturePaths[] = {
+    "assets/eagle.png",     "assets/redbrick.png",   "assets/purplestone.png",
+    "assets/greystone.png", "assets/bluestone.png",  "assets/mossy.png",
+    "assets/wood.png",      "assets/colorstone.png", "assets/barrel.png",
+    "assets/pillar.png",    "assets/greenlight.png"};
+
+static const std::string kFontPath = "assets/VT323-Regular.ttf";
+static constexpr int kFontSize = 24;
+
+SDL_Surface* loadImageFromFile(const std::string& filename, const SDL_PixelFormat& format) {
+  SDL_Surface* pSurface = nullptr;
+
+  SDL_Surface* pLoaded = IMG_Load(filename.c_str());
+  if (!pLoaded) {
+    std::cout << "Could not load texture '" << filename << "'" << std::endl;
+    return nullptr;
+  }
+
+  if (pLoaded->w != kTexWidth || pLoaded->h != kTexHeight) {
+    std::cout << "Invalid texture size for '" << filename << "', must be " << kTexWidth << " * "
+              << kTexHeight << std::endl;
+    SDL_FreeSurface(pLoaded);
+    return nullptr;
+  }
+
+  pSurface = SDL_ConvertSurface(pLoaded, &format, 0);
+  if (!pSurface) {
+    std::cout << "Could not optimize texture '" << filename
+              << "' to screen format: " << SDL_GetError() << std::endl;
+  }
+
+  SDL_FreeSurface(pLoaded);
+
+  return pSurface;
+}
+}  // namespace
+
+TTF_Font* loadFont() {
+  TTF_Font* pFont = TTF_OpenFont(kFontPath.c_str(), kFontSize);
+  if (!pFont) {
+    std::cout << "Could not load font '" << kFontPath << "': " << TTF_GetError() << std::endl;
+  }
+  return pFont;
+}
+
+bool loadTextures(RayCasterRenderer& renderer) {
+  for (std::size_t i = 0; i < count_of(kTexturePaths); ++i) {
+    SDL_Surface* pTexture = loadImageFromFile(kTexturePaths[i], *renderer.getPixelFormat());
+    if (pTexture) {
+      renderer.addTexture(pTexture);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<Sprite> createDefaultSprites() {
+  // clang-format off
+  return {
+    // green lights in every room
+    {Vector2d{20.5, 11.5}, 10, 0},
+    {Vector2d{18.5, 4.5}, 10, 0},
+    {Vector2d{10, 4.5}, 10, 0},
+    {Vector2d{10, 12.5}, 10, 0},
+    {Vector2d{3.5, 6.5}, 10, 0},
+    {Vector2d{3.5, 20.5}, 10, 0},
+    {Vector2d{3.5, 14.5}, 10, 0},
+    {Vector2d{14.5, 20.5}, 10, 0},
+
+    // row of pillars in front of wall
+    {Vector2d{18.5, 10.5}, 9, 0},
+    {Vector2d{18.5, 11.5}, 9, 0},
+    {Vector2d{18.5, 12.5}, 9, 0},
+
+    //some barrels around the map
+    {Vector2d{21.5, 1.5}, 8, 0},
+    {Vector2d{15.5, 1.5}, 8, 0},
+    {Vector2d{16.0, 1.8}, 8, 0},
+    {Vector2d{16.2, 1.2}, 8, 0},
+    {Vector2d{3.5,  2.5}, 8, 0},
+    {Vector2d{9.5, 15.5}, 8, 0},
+    {Vector2d{10.0, 15.1}, 8, 0},
+    {Vector2d{10.5, 15.8}, 8, 0},
+  };
+  // clang-format on
+}
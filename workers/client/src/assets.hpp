@@ -0,0 +1,16 @@
+#pragma once
+
+#include "raycast.hpp"
+#include "renderer.hpp"
+#include "sdl.hpp"
+#include <string>
+#include <vector>
+
+// Opens the HUD font, returns nullptr on failure
+TTF_Font* loadFont();
+
+// Loads all textures in the order the world map refers to them and hands them to the renderer
+bool loadTextures(RayCasterRenderer& renderer);
+
+// Sprites placed in the built-in world map
+std::vector<Sprite> createDefaultSprites();
@@ -0,0 +1,303 @@
+// Renders a scripted walk through the world map without a window and reports how long each
+// rendering pass takes, e.g.
+//
+//   bazel run -c opt //workers/client/src:benchmark -- --frames 1000 --threads 4
+#include "assets.hpp"
+#include "camera.hpp"
+#include "entityop.hpp"
+#include "entityview.hpp"
+#include "interestregion.hpp"
+#include "localserver.hpp"
+#include "networkthread.hpp"
+#include "player.hpp"
+#include "playerupdate.hpp"
+#include "profiler.hpp"
+#include "renderer.hpp"
+#include "sdl.hpp"
+#include "spritegrid.hpp"
+#include "spriteorder.hpp"
+#include "utils.hpp"
+#include "visibilityset.hpp"
+#include "worldmap.hpp"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace Eigen;
+
+namespace {
+static constexpr double kFov = 1;
+static constexpr double kSpriteDrawDistance = 64;
+// barrel, pillar and green light
+static const std::size_t kScatteredSpriteTextures[] = {8, 9, 10};
+static const SDL_Color kTextColor{255, 255, 255, 255};
+static constexpr unsigned int kLocalServerSeed = 1;
+
+struct Keyframe {
+  Vector2d pos;
+  double angle;  // radians, 0 looks along +y
+};
+
+// A loop through the rooms of the built-in map, two seconds per leg at 60 FPS
+static constexpr int kFramesPerKeyframe = 120;
+static constexpr double kPi = 3.14159265358979323846;
+// clang-format off
+static const Keyframe kCameraPath[] = {
+  {Vector2d{22.5, 11.5}, 0.5 * kPi},
+  {Vector2d{20.5, 11.5}, 0.0},
+  {Vector2d{20.5, 20.5}, 0.5 * kPi},
+  {Vector2d{9.5, 20.5}, 0.75 * kPi},
+  {Vector2d{3.5, 20.5}, kPi},
+  {Vector2d{3.5, 4.5}, 1.5 * kPi},
+  {Vector2d{9.5, 4.5}, 1.25 * kPi},
+  {Vector2d{20.5, 4.5}, 0.0},
+  {Vector2d{20.5, 11.5}, 1.5 * kPi},
+};
+// clang-format on
+
+struct Options {
+  int frames = 600;
+  int width = 1920;
+  int height = 1080;
+  std::size_t threads = 0;
+  bool fixedPoint = false;
+  std::string dumpPrefix;
+  int dumpEvery = 60;
+  std::string profileOutput;
+  std::string mapFile;
+  std::string visibilityFile;
+  int sprites = 0;
+  int entities = 0;
+};
+
+void printUsage() {
+  std::cout << "usage: benchmark [--frames N] [--width W] [--height H] [--threads N]"
+               " [--fixed-point] [--dump PREFIX] [--dump-every N]"
+               " [--profile-out FILE.csv|FILE.json] [--map FILE] [--pvs FILE] [--sprites N]"
+               " [--entities N]"
+            << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* pArg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (!std::strcmp(pArg, "--frames") && hasValue) {
+      options.frames = std::atoi(argv[++i]);
+    } else if (!std::strcmp(pArg, "--width") && hasValue) {
+      options.width = std::atoi(argv[++i]);
+    } else if (!std::strcmp(pArg, "--height") && hasValue) {
+      options.height = std::atoi(argv[++i]);
+    } else if (!std::strcmp(pArg, "--threads") && hasValue) {
+      options.threads = static_cast<std::size_t>(std::atoi(argv[++i]));
+    } else if (!std::strcmp(pArg, "--fixed-point")) {
+      options.fixedPoint = true;
+    } else if (!std::strcmp(pArg, "--dump") && hasValue) {
+      options.dumpPrefix = argv[++i];
+    } else if (!std::strcmp(pArg, "--dump-every") && hasValue) {
+      options.dumpEvery = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(pArg, "--profile-out") && hasValue) {
+      options.profileOutput = argv[++i];
+    } else if (!std::strcmp(pArg, "--map") && hasValue) {
+      options.mapFile = argv[++i];
+    } else if (!std::strcmp(pArg, "--pvs") && hasValue) {
+      options.visibilityFile = argv[++i];
+    } else if (!std::strcmp(pArg, "--sprites") && hasValue) {
+      options.sprites = std::atoi(argv[++i]);
+    } else if (!std::strcmp(pArg, "--entities") && hasValue) {
+      options.entities = std::atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options.frames > 0 && options.width > 0 && options.height > 0 && options.sprites >= 0 &&
+      options.entities >= 0;
+}
+
+// Position and view direction along the camera path at the given frame
+void evaluateCameraPath(int frame, Vector2d& pos, Vector2d& dir) {
+  const int keyframeCount = static_cast<int>(count_of(kCameraPath));
+  const int index = (frame / kFramesPerKeyframe) % keyframeCount;
+  const Keyframe& from = kCameraPath[index];
+  const Keyframe& to = kCameraPath[(index + 1) % keyframeCount];
+  const double t = (frame % kFramesPerKeyframe) / static_cast<double>(kFramesPerKeyframe);
+
+  pos = from.pos + (to.pos - from.pos) * t;
+  // always turn the short way round
+  const double turn = std::remainder(to.angle - from.angle, 2 * kPi);
+  dir = Rotation2Dd{from.angle + turn * t}.toRotationMatrix() * Vector2d{0, 1};
+}
+
+// Adds `count` sprites at random empty cells all over the map, to see how the sprite pass scales
+// with the number of sprites in the world
+void scatterSprites(WorldMap& world, int count, SpriteGrid& spriteGrid) {
+  std::mt19937 random{1};
+  std::uniform_real_distribution<double> x{0, static_cast<double>(world.width())};
+  std::uniform_real_distribution<double> y{0, static_cast<double>(world.height())};
+  std::uniform_int_distribution<std::size_t> texture{0, count_of(kScatteredSpriteTextures) - 1};
+  for (int placed = 0; placed < count;) {
+    const Vector2d pos{x(random), y(random)};
+    // makes sure the cell is loaded on large maps
+    world.update(pos);
+    if (world.isEmpty(pos.cast<int>())) {
+      spriteGrid.insert(Sprite{pos, kScatteredSpriteTextures[texture(random)], 0});
+      ++placed;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return -1;
+  }
+
+  int imgFlags = IMG_INIT_PNG;
+  if (!(IMG_Init(imgFlags) & imgFlags)) {
+    std::cout << "Could not initialize PNG library: " << IMG_GetError() << std::endl;
+    return -1;
+  }
+  if (TTF_Init() != 0) {
+    std::cout << "Could not initialize TTF library: " << TTF_GetError() << std::endl;
+    return -1;
+  }
+  TTF_Font* pFont = loadFont();
+  if (!pFont) {
+    return -1;
+  }
+
+  RayCasterRenderer renderer{nullptr,    pFont,      options.width, options.height,
+                             kTexWidth, kTexHeight, options.threads};
+  if (!loadTextures(renderer)) {
+    return -1;
+  }
+  renderer.setFloorTextureIndex(3);
+  renderer.setCeilingTextureIndex(6);
+  renderer.setRayCastPrecision(options.fixedPoint ? RayCastPrecision::FixedPoint
+                                                  : RayCastPrecision::Double);
+
+  // the camera path only visits the built-in rooms, which mapgen keeps in every generated map
+  WorldMap world;
+  if (!options.mapFile.empty() && !world.load(options.mapFile)) {
+    return -1;
+  }
+
+  SpriteGrid spriteGrid;
+  for (const Sprite& sprite : createDefaultSprites()) {
+    spriteGrid.insert(sprite);
+  }
+  scatterSprites(world, options.sprites, spriteGrid);
+  const double spriteRadius = static_cast<double>(options.height) / options.width * kFov + 0.5;
+  std::vector<SpriteGrid::SpriteId> visibleSprites;
+  SpriteOrder spriteOrder;
+
+  // entities replicated from a local server wander around the start of the camera path
+  EntityView entities{spriteGrid};
+  // only entities that may come into view are sent
+  InterestTracker interest{kSpriteDrawDistance, spriteRadius};
+  std::vector<EntityOp> ops;
+  std::unique_ptr<NetworkThread> pNetwork;
+  if (options.entities > 0) {
+    std::unique_ptr<LocalServer> pServer{
+        new LocalServer(options.mapFile, kCameraPath[0].pos, options.entities, kLocalServerSeed)};
+    if (!pServer->valid()) {
+      return -1;
+    }
+    // stepped once per frame by a fixed tick, so runs are reproducible
+    pNetwork.reset(new NetworkThread(std::move(pServer), true));
+  }
+
+  VisibilitySet visibility;
+  if (!options.visibilityFile.empty()) {
+    if (!visibility.load(options.visibilityFile, world)) {
+      return -1;
+    }
+    spriteGrid.setVisibilitySet(&visibility);
+  }
+
+  Profiler profiler{static_cast<std::size_t>(options.frames)};
+  renderer.setProfiler(&profiler);
+  char textBuffer[32];
+
+  for (int frame = 0; frame < options.frames; ++frame) {
+    Vector2d pos, dir;
+    evaluateCameraPath(frame, pos, dir);
+    Camera camera{dir, kFov};
+    Player player{pos, dir, camera};
+    snprintf(textBuffer, count_of(textBuffer), "Frame %d", frame);
+
+    {
+      ScopedTimer timer{&profiler, "frame"};
+      {
+        ScopedTimer timer{&profiler, "world"};
+        world.update(player.pos());
+      }
+      if (pNetwork) {
+        ScopedTimer timer{&profiler, "network"};
+        pNetwork->send(PlayerUpdate{player.pos(), player.dir()});
+        if (interest.update(player)) {
+          pNetwork->setInterest(interest.region());
+        }
+        pNetwork->tick();
+        pNetwork->receive(ops);
+        entities.apply(ops);
+        ops.clear();
+        // in step with the server's fixed ticks rather than the time frames take
+        entities.advance(1.0 / NetworkThread::kTickRate);
+      }
+      {
+        ScopedTimer timer{&profiler, "cull"};
+        visibleSprites.clear();
+        spriteGrid.query(player, kSpriteDrawDistance, spriteRadius, visibleSprites);
+        spriteOrder.update(spriteGrid, visibleSprites, player.pos());
+      }
+      // measure every frame in full, even where the camera path pauses
+      renderer.invalidate();
+      renderer.render(world, player, spriteOrder.sprites());
+      {
+        ScopedTimer timer{&profiler, "text"};
+        renderer.renderText(textBuffer, 10, 10, kTextColor);
+      }
+      renderer.present();
+    }
+
+    if (!options.dumpPrefix.empty() && frame % options.dumpEvery == 0) {
+      snprintf(textBuffer, count_of(textBuffer), "%05d.bmp", frame);
+      if (!renderer.saveBackBuffer(options.dumpPrefix + textBuffer)) {
+        return -1;
+      }
+    }
+  }
+
+  std::cout << options.frames << " frames at " << options.width << "x" << options.height << ", "
+            << renderer.threadCount() << " threads, "
+            << (options.fixedPoint ? "fixed point" : "double") << " DDA" << std::endl;
+  printf("%-8s %9s %9s %9s %9s %9s\n", "section", "mean ms", "p50 ms", "p95 ms", "p99 ms",
+         "max ms");
+  double frameMeanMs = 0;
+  for (const Profiler::Summary& summary : profiler.summarize()) {
+    printf("%-8s %9.3f %9.3f %9.3f %9.3f %9.3f\n", summary.name.c_str(), summary.meanMs,
+           summary.p50Ms, summary.p95Ms, summary.p99Ms, summary.maxMs);
+    if (summary.name == "frame") {
+      frameMeanMs = summary.meanMs;
+    }
+  }
+  printf("%.1f FPS\n", 1000.0 / frameMeanMs);
+
+  if (!options.profileOutput.empty() && !profiler.exportToFile(options.profileOutput)) {
+    return -1;
+  }
+
+  TTF_CloseFont(pFont);
+  return 0;
+}
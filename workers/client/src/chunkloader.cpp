@@ -0,0 +1,52 @@
+#include "chunkloader.hpp"
+
+ChunkLoader::ChunkLoader(LoadFunction load)
+: m_load(std::move(load)) {
+  m_thread = std::thread(&ChunkLoader::loaderLoop, this);
+}
+
+ChunkLoader::~ChunkLoader() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_requestCondition.notify_one();
+  m_thread.join();
+}
+
+void ChunkLoader::setRequests(const std::vector<int>& chunkIndices) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests = chunkIndices;
+    m_nextRequest = 0;
+  }
+  m_requestCondition.notify_one();
+}
+
+void ChunkLoader::collect(std::vector<LoadedChunk>& loaded) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (LoadedChunk& chunk : m_loaded) {
+    loaded.push_back(std::move(chunk));
+  }
+  m_loaded.clear();
+}
+
+void ChunkLoader::loaderLoop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_requestCondition.wait(lock, [this] { return m_quit || m_nextRequest < m_requests.size(); });
+    if (m_quit) {
+      return;
+    }
+
+    LoadedChunk chunk;
+    chunk.index = m_requests[m_nextRequest++];
+
+    // the owner may change the requests meanwhile, the chunk is delivered either way
+    lock.unlock();
+    m_load(chunk.index, chunk.cells);
+    lock.lock();
+
+    m_loaded.push_back(std::move(chunk));
+  }
+}
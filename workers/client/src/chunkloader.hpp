@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Loads world map chunks on a background thread. The owner decides which chunks it wants, the
+// loader only fills their cells and hands them back, so all bookkeeping stays on the owner's thread.
+class ChunkLoader {
+public:
+  // Fills `cells` with the contents of chunk `chunkIndex`, called on the loader thread
+  using LoadFunction = std::function<void(int chunkIndex, std::vector<std::uint8_t>& cells)>;
+
+  struct LoadedChunk {
+    int index;
+    std::vector<std::uint8_t> cells;
+  };
+
+  explicit ChunkLoader(LoadFunction load);
+  ~ChunkLoader();
+
+  ChunkLoader(const ChunkLoader&) = delete;
+  ChunkLoader& operator=(const ChunkLoader&) = delete;
+
+  // Replaces all pending requests, chunks are loaded in the given order. Requests that are no
+  // longer wanted are dropped, a chunk that is already being loaded is still delivered.
+  void setRequests(const std::vector<int>& chunkIndices);
+
+  // Moves all chunks loaded since the last call to the end of `loaded`
+  void collect(std::vector<LoadedChunk>& loaded);
+
+private:
+  void loaderLoop();
+
+  LoadFunction m_load;
+  std::thread m_thread;
+
+  std::mutex m_mutex;
+  std::condition_variable m_requestCondition;
+  std::vector<int> m_requests;
+  std::size_t m_nextRequest = 0;
+  std::vector<LoadedChunk> m_loaded;
+  bool m_quit = false;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+
+// Ids are assigned by the runtime and never reused while an entity exists
+using EntityId = std::int64_t;
+
+enum class EntityOpType : std::uint8_t {
+  Add,
+  Remove,
+  // new position and facing of an entity that has been added
+  Update,
+};
+
+// One change to the entities the client has checked out, as delivered by the runtime. Ops are
+// plain values, so batches of them can be handed around and reused without allocating.
+struct EntityOp {
+  EntityOpType type;
+  EntityId id;
+  // Add and Update: the state of the entity and the server time in seconds it belongs to
+  double time;
+  Eigen::Vector2d pos;
+  Eigen::Vector2d dir;
+  // Add only: the sprite the entity is drawn with, and whether it is another player
+  std::size_t texIndex;
+  bool isPlayer;
+};
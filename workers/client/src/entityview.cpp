@@ -0,0 +1,132 @@
+#include "entityview.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace Eigen;
+
+namespace {
+static constexpr double kDefaultInterpolationDelay = 0.1;
+// entities whose updates stop coming keep moving for this many seconds, then stop
+static constexpr double kMaxExtrapolation = 0.25;
+// fraction of the difference to the newest snapshot time the server time estimate makes up per
+// frame, and the difference after which it jumps there instead
+static constexpr double kClockCorrection = 0.05;
+static constexpr double kMaxClockError = 1.0;
+}  // namespace
+
+EntityView::EntityView(SpriteGrid& spriteGrid)
+: m_spriteGrid(spriteGrid), m_interpolationDelay(kDefaultInterpolationDelay) {}
+
+void EntityView::setInterpolationDelay(double delay) {
+  m_interpolationDelay = delay;
+}
+
+void EntityView::setInterpolation(Interpolation interpolation) {
+  m_interpolation = interpolation;
+}
+
+void EntityView::apply(const std::vector<EntityOp>& ops) {
+  for (const EntityOp& op : ops) {
+    switch (op.type) {
+    case EntityOpType::Add:
+      add(op);
+      break;
+
+    case EntityOpType::Remove:
+      remove(op.id);
+      break;
+
+    case EntityOpType::Update:
+      update(op);
+      break;
+    }
+
+    if (op.type != EntityOpType::Remove) {
+      if (!m_hasTime) {
+        m_serverTime = op.time;
+        m_hasTime = true;
+      }
+      m_newestTime = std::max(m_newestTime, op.time);
+    }
+  }
+}
+
+void EntityView::advance(double dt) {
+  if (!m_hasTime) {
+    return;
+  }
+
+  // the local clock drifts against the server's and updates arrive in bursts, so the estimate
+  // follows the newest snapshot gently instead of jumping to every new one
+  m_serverTime += dt;
+  m_serverTime += (m_newestTime - m_serverTime) * kClockCorrection;
+  if (std::abs(m_newestTime - m_serverTime) > kMaxClockError) {
+    m_serverTime = m_newestTime;
+  }
+
+  m_snapshots.evaluate(m_serverTime - m_interpolationDelay, m_interpolation, kMaxExtrapolation);
+  for (std::size_t slot = 0; slot < m_entities.size(); ++slot) {
+    const Entity& entity = m_entities[slot];
+    m_spriteGrid.move(entity.sprite, m_snapshots.pos(slot));
+    if (entity.player >= 0) {
+      RemotePlayer& player = m_players[entity.player];
+      player.pos = m_snapshots.pos(slot);
+      player.dir = m_snapshots.dir(slot);
+    }
+  }
+}
+
+void EntityView::add(const EntityOp& op) {
+  if (m_slots.count(op.id)) {
+    return;
+  }
+
+  Entity entity;
+  entity.sprite = m_spriteGrid.insert(Sprite{op.pos, op.texIndex, 0});
+  entity.player = -1;
+  if (op.isPlayer) {
+    entity.player = static_cast<int>(m_players.size());
+    m_players.push_back(RemotePlayer{op.id, op.pos, op.dir});
+  }
+
+  m_slots.emplace(op.id, m_snapshots.add(op.time, op.pos, op.dir));
+  m_ids.push_back(op.id);
+  m_entities.push_back(entity);
+}
+
+void EntityView::remove(EntityId id) {
+  const auto it = m_slots.find(id);
+  if (it == m_slots.end()) {
+    return;
+  }
+
+  const std::size_t slot = it->second;
+  const Entity entity = m_entities[slot];
+  m_spriteGrid.remove(entity.sprite);
+  if (entity.player >= 0) {
+    // the last player takes the place of the removed one
+    const RemotePlayer& last = m_players.back();
+    m_entities[m_slots[last.id]].player = entity.player;
+    m_players[entity.player] = last;
+    m_players.pop_back();
+  }
+
+  // and the last entity takes the removed entity's slot
+  m_slots.erase(it);
+  m_snapshots.remove(slot);
+  if (slot + 1 != m_ids.size()) {
+    m_ids[slot] = m_ids.back();
+    m_entities[slot] = m_entities.back();
+    m_slots[m_ids[slot]] = slot;
+  }
+  m_ids.pop_back();
+  m_entities.pop_back();
+}
+
+void EntityView::update(const EntityOp& op) {
+  const auto it = m_slots.find(op.id);
+  if (it == m_slots.end()) {
+    return;
+  }
+  m_snapshots.push(it->second, op.time, op.pos, op.dir);
+}
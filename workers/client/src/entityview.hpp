@@ -0,0 +1,75 @@
+#pragma once
+
+#include "entityop.hpp"
+#include "snapshotbuffer.hpp"
+#include "spritegrid.hpp"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// The client's copy of the replicated entities. Every entity is drawn as a sprite in the sprite
+// grid, other players are additionally kept with their facing. Updates are only recorded as
+// snapshots; `advance` places the entities once per frame a little behind the newest snapshots,
+// so they move smoothly even though updates arrive at a lower rate and not evenly spaced. Once
+// every block an entity visits has a bucket in the grid, updates do not allocate.
+class EntityView {
+public:
+  struct RemotePlayer {
+    EntityId id;
+    Eigen::Vector2d pos;
+    Eigen::Vector2d dir;
+  };
+
+  explicit EntityView(SpriteGrid& spriteGrid);
+  EntityView(const EntityView&) = delete;
+  EntityView& operator=(const EntityView&) = delete;
+
+  // How far in seconds entities are drawn behind the newest snapshots. It should cover a couple of
+  // server updates, so that there are usually snapshots on both sides to interpolate between.
+  void setInterpolationDelay(double delay);
+  void setInterpolation(Interpolation interpolation);
+
+  // Applies ops in order. Adds of known entities and updates or removes of unknown ones are
+  // ignored, the runtime may still deliver ops for an entity that just left the view.
+  void apply(const std::vector<EntityOp>& ops);
+
+  // Advances the view by `dt` seconds and moves every entity to where it was at that time minus
+  // the interpolation delay. Entities whose updates stop coming are extrapolated for a short while.
+  void advance(double dt);
+
+  std::size_t size() const {
+    return m_ids.size();
+  }
+
+  const std::vector<RemotePlayer>& players() const {
+    return m_players;
+  }
+
+private:
+  // what an entity in a slot of m_snapshots is drawn as
+  struct Entity {
+    SpriteGrid::SpriteId sprite;
+    // index into m_players, or -1 for entities that are not players
+    int player;
+  };
+
+  void add(const EntityOp& op);
+  void remove(EntityId id);
+  void update(const EntityOp& op);
+
+  SpriteGrid& m_spriteGrid;
+  // slot of every entity, entities occupy the same slots in m_ids, m_entities and m_snapshots
+  std::unordered_map<EntityId, std::size_t> m_slots;
+  std::vector<EntityId> m_ids;
+  std::vector<Entity> m_entities;
+  SnapshotBuffer m_snapshots;
+  std::vector<RemotePlayer> m_players;
+
+  Interpolation m_interpolation = Interpolation::Hermite;
+  double m_interpolationDelay;
+  // estimate of the current server time, follows the newest snapshot
+  double m_serverTime = 0;
+  double m_newestTime = 0;
+  bool m_hasTime = false;
+};
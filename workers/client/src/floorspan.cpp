@@ -0,0 +1,147 @@
+#include "floorspan.hpp"
+#include "shading.hpp"
+#include <cmath>
+#include <cstddef>
+
+#ifdef FLOORSPAN_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(FLOORSPAN_HAS_AVX2) && defined(__GNUC__)
+#define FLOORSPAN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FLOORSPAN_TARGET_AVX2
+#endif
+
+namespace {
+inline Uint32 sampleTexel(const SpanTexture& texture, std::uint32_t fracX,
+                          std::uint32_t fracY, int texWidthLog2, int texHeightLog2) {
+  const std::uint32_t u = fracX >> (32 - texWidthLog2);
+  const std::uint32_t v = fracY >> (32 - texHeightLog2);
+  return texture.pTexels[(u << texture.uShift) + (v << texture.vShift)];
+}
+
+// Draws pixels [first, span.count) of the span one at a time
+void drawFloorSpanTail(const FloorSpan& span, int first) {
+  std::uint32_t fracX = span.startX + static_cast<std::uint32_t>(first) * span.stepX;
+  std::uint32_t fracY = span.startY + static_cast<std::uint32_t>(first) * span.stepY;
+  for (int x = first; x < span.count; ++x) {
+    const Uint32 floorColor =
+        sampleTexel(span.floor, fracX, fracY, span.texWidthLog2, span.texHeightLog2);
+    const Uint32 ceilingColor =
+        sampleTexel(span.ceiling, fracX, fracY, span.texWidthLog2, span.texHeightLog2);
+    span.pFloorOut[x] = shadeColor(floorColor, span.shadeLevel) | 0xff000000;
+    span.pCeilingOut[x] = shadeColor(ceilingColor, span.shadeLevel) | 0xff000000;
+    fracX += span.stepX;
+    fracY += span.stepY;
+  }
+}
+
+#ifdef FLOORSPAN_HAS_AVX2
+// Same as `shadeColor`, 8 pixels at a time
+FLOORSPAN_TARGET_AVX2 inline __m256i shadePixels(__m256i colors, __m256i level) {
+  const __m256i lowBytes = _mm256_set1_epi32(0x00ff00ff);
+  const __m256i redBlue =
+      _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(colors, lowBytes), level), 8);
+  const __m256i greenAlpha = _mm256_andnot_si256(
+      lowBytes,
+      _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(colors, 8), lowBytes), level));
+  return _mm256_or_si256(redBlue, greenAlpha);
+}
+
+FLOORSPAN_TARGET_AVX2 inline void storePixels(Uint32* pOut, __m256i pixels, bool streaming) {
+  if (streaming) {
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(pOut), pixels);
+  } else {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOut), pixels);
+  }
+}
+#endif
+}  // namespace
+
+#ifdef FLOORSPAN_HAS_AVX2
+// 8 pixels per iteration: fixed point coordinates, gathered texel fetches and (when the rows are
+// suitably aligned) non-temporal stores, since the back buffer isn't read again this frame.
+FLOORSPAN_TARGET_AVX2 void drawFloorSpanAvx2(const FloorSpan& span) {
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i fracX = _mm256_add_epi32(
+      _mm256_set1_epi32(static_cast<int>(span.startX)),
+      _mm256_mullo_epi32(lane, _mm256_set1_epi32(static_cast<int>(span.stepX))));
+  __m256i fracY = _mm256_add_epi32(
+      _mm256_set1_epi32(static_cast<int>(span.startY)),
+      _mm256_mullo_epi32(lane, _mm256_set1_epi32(static_cast<int>(span.stepY))));
+  const __m256i stepX = _mm256_set1_epi32(static_cast<int>(span.stepX * 8));
+  const __m256i stepY = _mm256_set1_epi32(static_cast<int>(span.stepY * 8));
+  const __m128i shiftU = _mm_cvtsi32_si128(32 - span.texWidthLog2);
+  const __m128i shiftV = _mm_cvtsi32_si128(32 - span.texHeightLog2);
+  const __m128i floorShiftU = _mm_cvtsi32_si128(span.floor.uShift);
+  const __m128i floorShiftV = _mm_cvtsi32_si128(span.floor.vShift);
+  const __m128i ceilingShiftU = _mm_cvtsi32_si128(span.ceiling.uShift);
+  const __m128i ceilingShiftV = _mm_cvtsi32_si128(span.ceiling.vShift);
+  const __m256i level = _mm256_set1_epi16(static_cast<short>(span.shadeLevel));
+  const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xff000000));
+  const int* pFloorTexels = reinterpret_cast<const int*>(span.floor.pTexels);
+  const int* pCeilingTexels = reinterpret_cast<const int*>(span.ceiling.pTexels);
+
+  const bool streaming = (reinterpret_cast<std::uintptr_t>(span.pFloorOut) & 31) == 0 &&
+      (reinterpret_cast<std::uintptr_t>(span.pCeilingOut) & 31) == 0;
+
+  const int vectorCount = span.count & ~7;
+  for (int x = 0; x < vectorCount; x += 8) {
+    const __m256i u = _mm256_srl_epi32(fracX, shiftU);
+    const __m256i v = _mm256_srl_epi32(fracY, shiftV);
+    fracX = _mm256_add_epi32(fracX, stepX);
+    fracY = _mm256_add_epi32(fracY, stepY);
+
+    const __m256i floorIndex =
+        _mm256_add_epi32(_mm256_sll_epi32(u, floorShiftU), _mm256_sll_epi32(v, floorShiftV));
+    const __m256i ceilingIndex =
+        _mm256_add_epi32(_mm256_sll_epi32(u, ceilingShiftU), _mm256_sll_epi32(v, ceilingShiftV));
+    const __m256i floorColor =
+        shadePixels(_mm256_i32gather_epi32(pFloorTexels, floorIndex, 4), level);
+    const __m256i ceilingColor =
+        shadePixels(_mm256_i32gather_epi32(pCeilingTexels, ceilingIndex, 4), level);
+
+    storePixels(span.pFloorOut + x, _mm256_or_si256(floorColor, opaque), streaming);
+    storePixels(span.pCeilingOut + x, _mm256_or_si256(ceilingColor, opaque), streaming);
+  }
+  if (streaming) {
+    // make the non-temporal stores visible before anybody else touches the back buffer
+    _mm_sfence();
+  }
+
+  drawFloorSpanTail(span, vectorCount);
+}
+#endif
+
+namespace {
+using FloorSpanKernel = void (*)(const FloorSpan&);
+
+FloorSpanKernel selectFloorSpanKernel() {
+#ifdef FLOORSPAN_HAS_AVX2
+  if (SDL_HasAVX2()) {
+    return &drawFloorSpanAvx2;
+  }
+#endif
+  return &drawFloorSpanScalar;
+}
+
+const FloorSpanKernel kFloorSpanKernel = selectFloorSpanKernel();
+}  // namespace
+
+std::uint32_t toFloorFraction(double value) {
+  // rows at the horizon are infinitely far away, any texel will do there
+  if (!std::isfinite(value)) {
+    return 0;
+  }
+  const double fraction = value - std::floor(value);
+  return static_cast<std::uint32_t>(static_cast<std::uint64_t>(fraction * 4294967296.0));
+}
+
+void drawFloorSpan(const FloorSpan& span) {
+  kFloorSpanKernel(span);
+}
+
+void drawFloorSpanScalar(const FloorSpan& span) {
+  drawFloorSpanTail(span, 0);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "sdl.hpp"
+#include <cstdint>
+
+// A 32 bit texture read by the floor span kernels.
+// Texel (u, v) lives at pTexels[(u << uShift) + (v << vShift)].
+struct SpanTexture {
+  const Uint32* pTexels;
+  int uShift;
+  int vShift;
+};
+
+// One horizontal run of floor pixels together with its mirrored ceiling run.
+//
+// Only the position of a pixel within its map cell matters for texturing, so world coordinates are
+// kept as 0.32 fixed point fractions that are allowed to wrap around. That keeps the per pixel step
+// exact integer arithmetic, which is what lets the SIMD kernels match the scalar one bit for bit.
+struct FloorSpan {
+  std::uint32_t startX;
+  std::uint32_t startY;
+  std::uint32_t stepX;
+  std::uint32_t stepY;
+  int texWidthLog2;
+  int texHeightLog2;
+  // applied to every texel, see shading.hpp
+  unsigned int shadeLevel;
+  int count;
+  SpanTexture floor;
+  SpanTexture ceiling;
+  Uint32* pFloorOut;
+  Uint32* pCeilingOut;
+};
+
+// Converts a world coordinate (or step) to the wrapped 0.32 fixed point fraction used by FloorSpan
+std::uint32_t toFloorFraction(double value);
+
+// Draws the span with the fastest kernel the CPU supports
+void drawFloorSpan(const FloorSpan& span);
+
+// Portable reference kernel, produces exactly the same pixels as the vectorized ones
+void drawFloorSpanScalar(const FloorSpan& span);
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define FLOORSPAN_HAS_AVX2 1
+// 8 pixels at a time, only for CPUs with AVX2 (see SDL_HasAVX2)
+void drawFloorSpanAvx2(const FloorSpan& span);
+#endif
@@ -0,0 +1,119 @@
+// Checks that the AVX2 floor span kernel draws exactly the same pixels as the scalar one on random
+// spans, textures and shade levels. Exits with a non-zero status on the first span where they
+// differ, and skips the comparison on CPUs without AVX2.
+
+#include "floorspan.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+static constexpr unsigned int kSeed = 1;
+static constexpr int kSpans = 20000;
+static constexpr int kTexSizeLog2 = 6;
+static constexpr int kTexSize = 1 << kTexSizeLog2;
+static constexpr int kMaxCount = 1000;
+// spans start up to this many pixels past a 32 byte boundary, so both the streaming and the
+// unaligned stores are used
+static constexpr int kMaxOffset = 8;
+// pixels past the end of the span that must stay untouched
+static constexpr int kGuard = 8;
+static constexpr double kMaxCoordinate = 1e9;
+static constexpr double kMaxStep = 4;
+
+// Out buffers for one kernel, floor and ceiling rows starting on a 32 byte boundary
+struct Rows {
+  explicit Rows(std::size_t size)
+  : m_pixels(2 * size + 16) {
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(m_pixels.data());
+    pFloor = m_pixels.data() + ((32 - (address & 31)) & 31) / sizeof(Uint32);
+    pCeiling = pFloor + size;
+  }
+
+  Uint32* pFloor;
+  Uint32* pCeiling;
+
+private:
+  std::vector<Uint32> m_pixels;
+};
+}  // namespace
+
+int main() {
+#ifdef FLOORSPAN_HAS_AVX2
+  if (!SDL_HasAVX2()) {
+    std::cout << "The CPU has no AVX2, nothing to compare" << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  std::mt19937 random{kSeed};
+  std::uniform_int_distribution<Uint32> texel;
+  std::vector<Uint32> floorTexels(kTexSize * kTexSize);
+  std::vector<Uint32> ceilingTexels(kTexSize * kTexSize);
+  for (std::size_t i = 0; i < floorTexels.size(); ++i) {
+    floorTexels[i] = texel(random);
+    ceilingTexels[i] = texel(random);
+  }
+
+  // the row size is a multiple of 8 pixels, so the ceiling rows are aligned like the floor rows
+  const std::size_t rowSize = kMaxOffset + kMaxCount + kGuard;
+  Rows scalarRows{rowSize};
+  Rows avx2Rows{rowSize};
+
+  std::uniform_real_distribution<double> coordinate{-kMaxCoordinate, kMaxCoordinate};
+  std::uniform_real_distribution<double> step{-kMaxStep, kMaxStep};
+  std::uniform_int_distribution<unsigned int> shadeLevel{0, 256};
+  std::uniform_int_distribution<int> offset{0, kMaxOffset};
+  std::uniform_int_distribution<int> shortCount{0, 24};
+  std::uniform_int_distribution<int> longCount{0, kMaxCount};
+  std::uniform_int_distribution<int> layout{0, 1};
+  for (int i = 0; i < kSpans; ++i) {
+    // texels column after column like in the atlas, or row after row
+    const bool columnMajor = layout(random) == 1;
+    const int uShift = columnMajor ? kTexSizeLog2 : 0;
+    const int vShift = columnMajor ? 0 : kTexSizeLog2;
+
+    // mostly far from the origin in either direction, where little of the fraction is left
+    const double startX = i % 4 == 0 ? coordinate(random) / 1e6 : coordinate(random);
+    const double startY = i % 4 == 1 ? coordinate(random) / 1e6 : coordinate(random);
+    const int first = offset(random);
+
+    FloorSpan span;
+    span.startX = toFloorFraction(startX);
+    span.startY = toFloorFraction(startY);
+    span.stepX = toFloorFraction(step(random));
+    span.stepY = toFloorFraction(step(random));
+    span.texWidthLog2 = kTexSizeLog2;
+    span.texHeightLog2 = kTexSizeLog2;
+    span.shadeLevel = shadeLevel(random);
+    // half of the spans are short, so the pixels after the last 8 make up much of them
+    span.count = i % 2 == 0 ? shortCount(random) : longCount(random);
+    span.floor = SpanTexture{floorTexels.data(), uShift, vShift};
+    span.ceiling = SpanTexture{ceilingTexels.data(), uShift, vShift};
+
+    std::memset(scalarRows.pFloor, 0x5a, 2 * rowSize * sizeof(Uint32));
+    std::memset(avx2Rows.pFloor, 0x5a, 2 * rowSize * sizeof(Uint32));
+
+    span.pFloorOut = scalarRows.pFloor + first;
+    span.pCeilingOut = scalarRows.pCeiling + first;
+    drawFloorSpanScalar(span);
+    span.pFloorOut = avx2Rows.pFloor + first;
+    span.pCeilingOut = avx2Rows.pCeiling + first;
+    drawFloorSpanAvx2(span);
+
+    if (std::memcmp(scalarRows.pFloor, avx2Rows.pFloor, 2 * rowSize * sizeof(Uint32)) != 0) {
+      std::cout << "Span " << i << " of " << span.count << " pixels from (" << startX << ", "
+                << startY << ") at offset " << first << " differs between the kernels"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::cout << kSpans << " spans agree" << std::endl;
+#else
+  std::cout << "No AVX2 kernel on this architecture, nothing to compare" << std::endl;
+#endif
+  return EXIT_SUCCESS;
+}
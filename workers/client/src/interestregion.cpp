@@ -0,0 +1,57 @@
+#include "interestregion.hpp"
+#include <cmath>
+
+using namespace Eigen;
+
+namespace {
+static constexpr double kPi = 3.14159265358979323846;
+// how far the camera moves and turns before the region is made again
+static constexpr double kUpdateDistance = 0.5;
+static constexpr double kUpdateAngle = 10 * kPi / 180;
+// entities keep moving while the region is on its way to the server and their updates on their
+// way back
+static constexpr double kMovementMargin = 1;
+static constexpr double kNearRadius = 4;
+}  // namespace
+
+bool InterestRegion::contains(const Vector2d& point, double slack) const {
+  const Vector2d offset = point - pos;
+  const double squaredDistance = offset.squaredNorm();
+  const double near = nearRadius + slack;
+  if (squaredDistance <= near * near) {
+    return true;
+  }
+  const double far = maxDistance + margin + slack;
+  if (squaredDistance > far * far) {
+    return false;
+  }
+
+  const bool insideLeft = offset.dot(leftNormal) <= margin + slack;
+  const bool insideRight = offset.dot(rightNormal) <= margin + slack;
+  return reflex ? insideLeft || insideRight : insideLeft && insideRight;
+}
+
+InterestTracker::InterestTracker(double maxDistance, double spriteRadius)
+: m_maxDistance(maxDistance), m_spriteRadius(spriteRadius) {}
+
+bool InterestTracker::update(const Player& player) {
+  const Vector2d forward = player.dir().normalized();
+  if (m_hasRegion && (player.pos() - m_region.pos).norm() <= kUpdateDistance &&
+      forward.dot(m_forward) >= std::cos(kUpdateAngle)) {
+    return false;
+  }
+
+  // the side edges are turned outwards by the angle the camera may turn until the next update
+  const double halfAngle =
+      std::atan2(player.camera().plane().norm(), player.dir().norm()) + kUpdateAngle;
+  m_region.pos = player.pos();
+  m_region.leftNormal = Rotation2Dd{halfAngle + kPi / 2}.toRotationMatrix() * forward;
+  m_region.rightNormal = Rotation2Dd{-halfAngle - kPi / 2}.toRotationMatrix() * forward;
+  m_region.reflex = halfAngle > kPi / 2;
+  m_region.maxDistance = m_maxDistance;
+  m_region.margin = m_spriteRadius + kUpdateDistance + kMovementMargin;
+  m_region.nearRadius = kNearRadius + kUpdateDistance;
+  m_forward = forward;
+  m_hasRegion = true;
+  return true;
+}
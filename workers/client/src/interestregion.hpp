@@ -0,0 +1,46 @@
+#pragma once
+
+#include "player.hpp"
+#include <Eigen/Dense>
+
+// The part of the world the client wants entities from: the view frustum out to the draw
+// distance grown by a margin, plus everything close to the camera, so entities right behind the
+// player are there when it turns around.
+struct InterestRegion {
+  Eigen::Vector2d pos;
+  // outward normals of the side edges
+  Eigen::Vector2d leftNormal;
+  Eigen::Vector2d rightNormal;
+  // the side edges are more than 180 degrees apart, beyond either of them is inside
+  bool reflex;
+  double maxDistance;
+  double margin;
+  double nearRadius;
+
+  // Whether `point` is inside the region grown by `slack`
+  bool contains(const Eigen::Vector2d& point, double slack) const;
+};
+
+// Derives the interest region from the camera. A new region is only made once the camera has
+// moved or turned noticeably since the last one. Regions are grown by those amounts, so
+// everything the camera can see in between stays inside.
+class InterestTracker {
+public:
+  // `maxDistance` and `spriteRadius` as sprites are culled with
+  InterestTracker(double maxDistance, double spriteRadius);
+
+  // Returns whether there is a new region that should be sent to the server
+  bool update(const Player& player);
+
+  const InterestRegion& region() const {
+    return m_region;
+  }
+
+private:
+  double m_maxDistance;
+  double m_spriteRadius;
+  InterestRegion m_region;
+  // the camera direction the region was made for, normalized
+  Eigen::Vector2d m_forward;
+  bool m_hasRegion = false;
+};
@@ -0,0 +1,130 @@
+#include "localserver.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace Eigen;
+
+namespace {
+static constexpr double kWalkSpeed = 1.5;
+// a long stall is simulated as one short step rather than moving everything through walls
+static constexpr double kMaxStep = 0.1;
+// on average each entity is replaced by a new one once a minute
+static constexpr double kLeaveRate = 1.0 / 60.0;
+// how far outside the client's interest region entities it has are still sent
+static constexpr double kLeaveMargin = 1;
+// entities spawn within a chunk of the spawn point and wander off from there
+static constexpr double kSpawnRadius = WorldMap::kChunkSize;
+static constexpr int kSpawnAttempts = 64;
+static constexpr double kPi = 3.14159265358979323846;
+// barrel and green light, other players are pillars until they have a texture of their own
+static const std::size_t kEntityTextures[] = {8, 10};
+static constexpr std::size_t kPlayerTexture = 9;
+}  // namespace
+
+LocalServer::LocalServer(const std::string& mapFile, const Vector2d& spawnPos, int entityCount,
+                         unsigned int seed)
+: m_spawnPos(spawnPos), m_random(seed), m_clientPlayer{spawnPos, Vector2d{0, 1}} {
+  if (!mapFile.empty() && !m_world.load(mapFile)) {
+    m_valid = false;
+    return;
+  }
+  // walkers go anywhere on the map, not just near the client's player
+  m_world.loadAll();
+
+  for (int i = 0; i < entityCount; ++i) {
+    m_walkers.push_back(spawn(i % 4 == 3));
+  }
+}
+
+void LocalServer::update(double dt, std::vector<EntityOp>& ops) {
+  dt = std::min(dt, kMaxStep);
+  m_time += dt;
+  std::uniform_real_distribution<double> chance{0, 1};
+  for (Walker& walker : m_walkers) {
+    if (chance(m_random) < dt * kLeaveRate) {
+      if (walker.added) {
+        ops.push_back(
+            EntityOp{EntityOpType::Remove, walker.id, m_time, walker.pos, walker.dir, 0, false});
+      }
+      walker = spawn(walker.isPlayer);
+    } else {
+      walk(walker, dt);
+    }
+
+    // entities leave the region only once they are a margin outside of it, so entities on its
+    // edge do not come and go
+    const bool interesting =
+        !m_hasInterest || m_interest.contains(walker.pos, walker.added ? kLeaveMargin : 0);
+    if (walker.added && !interesting) {
+      ops.push_back(
+          EntityOp{EntityOpType::Remove, walker.id, m_time, walker.pos, walker.dir, 0, false});
+      walker.added = false;
+    } else if (!walker.added && interesting) {
+      ops.push_back(EntityOp{EntityOpType::Add, walker.id, m_time, walker.pos, walker.dir,
+                             walker.texIndex, walker.isPlayer});
+      walker.added = true;
+    } else if (walker.added) {
+      ops.push_back(
+          EntityOp{EntityOpType::Update, walker.id, m_time, walker.pos, walker.dir, 0, false});
+    }
+  }
+}
+
+void LocalServer::setInterest(const InterestRegion& region) {
+  m_interest = region;
+  m_hasInterest = true;
+}
+
+void LocalServer::receive(const std::uint8_t* pData, std::size_t size) {
+  std::size_t offset = 0;
+  while (offset < size) {
+    const std::size_t length = m_playerDecoder.decode(pData + offset, size - offset, m_clientPlayer);
+    if (length == 0) {
+      std::cout << "Dropping malformed player update" << std::endl;
+      return;
+    }
+    offset += length;
+  }
+}
+
+LocalServer::Walker LocalServer::spawn(bool isPlayer) {
+  std::uniform_real_distribution<double> x{std::max(m_spawnPos.x() - kSpawnRadius, 0.0),
+                                            std::min(m_spawnPos.x() + kSpawnRadius,
+                                                     static_cast<double>(m_world.width()))};
+  std::uniform_real_distribution<double> y{std::max(m_spawnPos.y() - kSpawnRadius, 0.0),
+                                            std::min(m_spawnPos.y() + kSpawnRadius,
+                                                     static_cast<double>(m_world.height()))};
+  std::uniform_real_distribution<double> angle{0, 2 * kPi};
+
+  Walker walker;
+  walker.id = m_nextId++;
+  walker.pos = m_spawnPos;
+  for (int attempt = 0; attempt < kSpawnAttempts; ++attempt) {
+    const Vector2d pos{x(m_random), y(m_random)};
+    if (m_world.isEmpty(Vector2i{static_cast<int>(std::floor(pos.x())),
+                                 static_cast<int>(std::floor(pos.y()))})) {
+      walker.pos = pos;
+      break;
+    }
+  }
+  walker.dir = Rotation2Dd{angle(m_random)}.toRotationMatrix() * Vector2d{0, 1};
+  walker.texIndex = isPlayer ? kPlayerTexture
+                             : kEntityTextures[m_random() % count_of(kEntityTextures)];
+  walker.isPlayer = isPlayer;
+  walker.added = false;
+  return walker;
+}
+
+void LocalServer::walk(Walker& walker, double dt) {
+  const Vector2d pos = walker.pos + walker.dir * (kWalkSpeed * dt);
+  if (m_world.isEmpty(Vector2i{static_cast<int>(std::floor(pos.x())),
+                               static_cast<int>(std::floor(pos.y()))})) {
+    walker.pos = pos;
+  } else {
+    // turn somewhere else and try again next time
+    std::uniform_real_distribution<double> angle{0, 2 * kPi};
+    walker.dir = Rotation2Dd{angle(m_random)}.toRotationMatrix() * Vector2d{0, 1};
+  }
+}
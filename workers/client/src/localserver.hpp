@@ -0,0 +1,82 @@
+#pragma once
+
+#include "entityop.hpp"
+#include "interestregion.hpp"
+#include "playerupdate.hpp"
+#include "worldmap.hpp"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Stands in for the SpatialOS runtime while there is none to connect to: it simulates entities
+// wandering the empty cells around a spawn point and reports them as ops, so replication can be
+// exercised locally. Like a real server it has its own copy of the map.
+class LocalServer {
+public:
+  // Spawns `entityCount` entities around `spawnPos`, every fourth of them a player. The map is
+  // loaded from `mapFile`, or the built-in map is used if it is empty.
+  LocalServer(const std::string& mapFile, const Eigen::Vector2d& spawnPos, int entityCount,
+              unsigned int seed);
+  LocalServer(const LocalServer&) = delete;
+  LocalServer& operator=(const LocalServer&) = delete;
+
+  // False if the map could not be loaded
+  bool valid() const {
+    return m_valid;
+  }
+
+  // Advances the simulation by `dt` seconds and appends the ops a client would receive: an update
+  // for every entity in the client's interest region, adds for entities that entered it or were
+  // spawned inside it and removes for entities that left it or left the world.
+  void update(double dt, std::vector<EntityOp>& ops);
+
+  // Only entities inside `region` are sent from now on. Until the first region arrives every
+  // entity is.
+  void setInterest(const InterestRegion& region);
+
+  // Takes `size` bytes of encoded player updates from the client
+  void receive(const std::uint8_t* pData, std::size_t size);
+
+  // Sequence number of the newest player update received, to be acknowledged to the client
+  bool hasAcknowledgedPlayerUpdate() const {
+    return m_playerDecoder.hasAcknowledged();
+  }
+  std::uint16_t acknowledgedPlayerUpdate() const {
+    return m_playerDecoder.acknowledged();
+  }
+
+  // The client's player as of its last update
+  const PlayerUpdate& clientPlayer() const {
+    return m_clientPlayer;
+  }
+
+private:
+  struct Walker {
+    EntityId id;
+    Eigen::Vector2d pos;
+    Eigen::Vector2d dir;
+    std::size_t texIndex;
+    bool isPlayer;
+    // whether the client has the entity
+    bool added;
+  };
+
+  Walker spawn(bool isPlayer);
+  void walk(Walker& walker, double dt);
+
+  WorldMap m_world;
+  Eigen::Vector2d m_spawnPos;
+  std::mt19937 m_random;
+  // seconds simulated so far
+  double m_time = 0;
+  EntityId m_nextId = 1;
+  std::vector<Walker> m_walkers;
+  InterestRegion m_interest;
+  bool m_hasInterest = false;
+  PlayerUpdateDecoder m_playerDecoder;
+  PlayerUpdate m_clientPlayer;
+  bool m_valid = true;
+};
@@ -0,0 +1,195 @@
+// Drives the entity view with the local server's ops and checks after every tick that the sprite
+// grid and the view's players match the entities the ops describe. Entities leaving the world, and
+// later the interest region, remove entities from the middle of the view's slots.
+// Also checks that the player update decoder skips deltas against baselines it never decoded.
+// Exits with a non-zero status on the first mismatch.
+
+#include "entityview.hpp"
+#include "interestregion.hpp"
+#include "localserver.hpp"
+#include "player.hpp"
+#include "playerupdate.hpp"
+#include "spritegrid.hpp"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+using namespace Eigen;
+
+namespace {
+static constexpr int kEntityCount = 200;
+static constexpr unsigned int kSeed = 1;
+static constexpr double kTickSeconds = 1.0 / 60;
+// a minute of ticks, the second half with an interest region
+static constexpr int kTicks = 3600;
+static constexpr int kInterestTick = kTicks / 2;
+static constexpr double kMaxDistance = 8;
+static constexpr double kSpriteRadius = 0.5;
+// further than any two cells of the built-in map are apart
+static constexpr double kQueryDistance = 1000;
+// each of the four cameras that cover the whole map sees 90 degrees
+static constexpr double kQueryFov = 1;
+
+// what the ops say an entity is
+struct Expected {
+  Vector2d pos;
+  Vector2d dir;
+  std::size_t texIndex;
+  bool isPlayer;
+};
+
+using Placement = std::tuple<double, double, std::size_t>;
+
+bool fail(int tick, const char* pWhat) {
+  std::cout << "Tick " << tick << ": " << pWhat << std::endl;
+  return false;
+}
+
+void record(const std::vector<EntityOp>& ops, std::map<EntityId, Expected>& expected) {
+  for (const EntityOp& op : ops) {
+    switch (op.type) {
+    case EntityOpType::Add:
+      expected[op.id] = Expected{op.pos, op.dir, op.texIndex, op.isPlayer};
+      break;
+
+    case EntityOpType::Remove:
+      expected.erase(op.id);
+      break;
+
+    case EntityOpType::Update:
+      expected[op.id].pos = op.pos;
+      expected[op.id].dir = op.dir;
+      break;
+    }
+  }
+}
+
+// The sprites in the grid, found by looking in four directions from the middle of the map
+std::vector<Placement> spritesInGrid(const SpriteGrid& spriteGrid, const Vector2d& center) {
+  std::vector<SpriteGrid::SpriteId> ids;
+  for (const Vector2d& dir : {Vector2d{1, 0}, Vector2d{0, 1}, Vector2d{-1, 0}, Vector2d{0, -1}}) {
+    Camera camera{dir, kQueryFov};
+    const Player player{center, dir, camera};
+    spriteGrid.query(player, kQueryDistance, kSpriteRadius, ids);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  std::vector<Placement> sprites;
+  for (SpriteGrid::SpriteId id : ids) {
+    const Sprite& sprite = spriteGrid.sprite(id);
+    sprites.emplace_back(sprite.pos.x(), sprite.pos.y(), sprite.texIndex);
+  }
+  std::sort(sprites.begin(), sprites.end());
+  return sprites;
+}
+
+bool check(int tick, const std::map<EntityId, Expected>& expected, const EntityView& view,
+           const SpriteGrid& spriteGrid, const Vector2d& center) {
+  if (view.size() != expected.size() || spriteGrid.size() != expected.size()) {
+    return fail(tick, "the view or the sprite grid has a different number of entities");
+  }
+
+  std::vector<Placement> placements;
+  std::size_t playerCount = 0;
+  for (const auto& entry : expected) {
+    const Expected& entity = entry.second;
+    placements.emplace_back(entity.pos.x(), entity.pos.y(), entity.texIndex);
+    playerCount += entity.isPlayer;
+  }
+  std::sort(placements.begin(), placements.end());
+  if (spritesInGrid(spriteGrid, center) != placements) {
+    return fail(tick, "the sprite grid does not have the sprites of the entities");
+  }
+
+  if (view.players().size() != playerCount) {
+    return fail(tick, "the view has a different number of players");
+  }
+  for (const EntityView::RemotePlayer& player : view.players()) {
+    const auto it = expected.find(player.id);
+    if (it == expected.end() || !it->second.isPlayer) {
+      return fail(tick, "the view has a player that is not one");
+    }
+    if (player.pos != it->second.pos || player.dir != it->second.dir) {
+      return fail(tick, "a player is not where its last update put it");
+    }
+  }
+  return true;
+}
+
+// Feeds a fresh decoder a delta message whose baseline it never saw, which has to leave the update
+// alone and is not acknowledged
+bool checkUnknownBaseline() {
+  PlayerUpdateEncoder encoder;
+  std::vector<std::uint8_t> message;
+  encoder.encode(PlayerUpdate{Vector2d{2, 3}, Vector2d{1, 0}}, message);
+  encoder.acknowledge(0);
+  message.clear();
+  if (!encoder.encode(PlayerUpdate{Vector2d{4, 5}, Vector2d{0, 1}}, message)) {
+    return fail(0, "the encoder sent no delta");
+  }
+
+  PlayerUpdateDecoder decoder;
+  const PlayerUpdate untouched{Vector2d{-1, -1}, Vector2d{-1, -1}};
+  PlayerUpdate update = untouched;
+  if (decoder.decode(message.data(), message.size(), update) != message.size()) {
+    return fail(0, "a delta with an unknown baseline was not skipped");
+  }
+  if (update.pos != untouched.pos || update.dir != untouched.dir || decoder.hasAcknowledged()) {
+    return fail(0, "a delta with an unknown baseline was decoded");
+  }
+  return true;
+}
+}  // namespace
+
+int main() {
+  if (!checkUnknownBaseline()) {
+    return EXIT_FAILURE;
+  }
+
+  WorldMap world;
+  const Vector2d center{world.width() / 2.0, world.height() / 2.0};
+  LocalServer server{"", center, kEntityCount, kSeed};
+  if (!server.valid()) {
+    return EXIT_FAILURE;
+  }
+
+  SpriteGrid spriteGrid;
+  EntityView view{spriteGrid};
+  // The first ops set the view's clock and every later tick advances it like the server's, so
+  // without a delay every entity is drawn exactly at its newest snapshot
+  view.setInterpolationDelay(0);
+
+  std::map<EntityId, Expected> expected;
+  std::vector<EntityOp> ops;
+  int removes = 0;
+  for (int tick = 0; tick < kTicks; ++tick) {
+    if (tick == kInterestTick) {
+      Camera camera{Vector2d{1, 0}, kQueryFov};
+      const Player player{center, Vector2d{1, 0}, camera};
+      InterestTracker tracker{kMaxDistance, kSpriteRadius};
+      tracker.update(player);
+      server.setInterest(tracker.region());
+    }
+
+    ops.clear();
+    server.update(kTickSeconds, ops);
+    removes += std::count_if(ops.begin(), ops.end(),
+                             [](const EntityOp& op) { return op.type == EntityOpType::Remove; });
+    record(ops, expected);
+    view.apply(ops);
+    view.advance(tick == 0 ? 0 : kTickSeconds);
+    if (!check(tick, expected, view, spriteGrid, center)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::cout << kTicks << " ticks agree, " << removes << " entities were removed, "
+            << expected.size() << " are left" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -1,11 +1,25 @@
+#include "assets.hpp"
 #include "camera.hpp"
+#include "entityop.hpp"
+#include "entityview.hpp"
+#include "interestregion.hpp"
+#include "localserver.hpp"
+#include "networkthread.hpp"
 #include "player.hpp"
+#include "playerupdate.hpp"
+#include "profiler.hpp"
 #include "renderer.hpp"
 #include "sdl.hpp"
+#include "spritegrid.hpp"
+#include "spriteorder.hpp"
 #include "utils.hpp"
+#include "visibilityset.hpp"
 #include "worldmap.hpp"
 #include <Eigen/Dense>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
 
 using namespace Eigen;
@@ -13,51 +27,28 @@ using namespace Eigen;
 namespace {
 static constexpr int kScreenWidth = 1920;
 static constexpr int kScreenHeight = 1080;
-static constexpr int kTexWidth = 64;
-static constexpr int kTexHeight = 64;
 static constexpr double kFov = 1;
+// sprites further away are less than 1/64 of the screen tall
+static constexpr double kSpriteDrawDistance = 64;
 static constexpr double kMoveSpeed = 5.0;
 static constexpr double kTurnSpeed = 3.0;
+static constexpr std::size_t kRenderThreads = 0;  // 0 = one per hardware core
 static const Vector2d kStartPos = Vector2d{22, 11.5};
 static const Vector2d kStartDir = Vector2d{0, 1};
+static constexpr unsigned int kLocalServerSeed = 1;
 
-static const std::string kTexturePaths[] = {
-    "assets/eagle.png",     "assets/redbrick.png",   "assets/purplestone.png",
-    "assets/greystone.png", "assets/bluestone.png",  "assets/mossy.png",
-    "assets/wood.png",      "assets/colorstone.png", "assets/barrel.png",
-    "assets/pillar.png",    "assets/greenlight.png"};
-
-static const std::string kFontPath = "assets/VT323-Regular.ttf";
 static const SDL_Color kTextColor{255, 255, 255, 255};
 
-// clang-format off
-static std::vector<Sprite> kSprites = {
-  // green lights in every room
-  {Vector2d{20.5, 11.5}, 10, 0},
-  {Vector2d{18.5, 4.5}, 10, 0},
-  {Vector2d{10, 4.5}, 10, 0},
-  {Vector2d{10, 12.5}, 10, 0},
-  {Vector2d{3.5, 6.5}, 10, 0},
-  {Vector2d{3.5, 20.5}, 10, 0},
-  {Vector2d{3.5, 14.5}, 10, 0},
-  {Vector2d{14.5, 20.5}, 10, 0},
-
-  // row of pillars in front of wall
-  {Vector2d{18.5, 10.5}, 9, 0},
-  {Vector2d{18.5, 11.5}, 9, 0},
-  {Vector2d{18.5, 12.5}, 9, 0},
-
-  //some barrels around the map
-  {Vector2d{21.5, 1.5}, 8, 0},
-  {Vector2d{15.5, 1.5}, 8, 0},
-  {Vector2d{16.0, 1.8}, 8, 0},
-  {Vector2d{16.2, 1.2}, 8, 0},
-  {Vector2d{3.5,  2.5}, 8, 0},
-  {Vector2d{9.5, 15.5}, 8, 0},
-  {Vector2d{10.0, 15.1}, 8, 0},
-  {Vector2d{10.5, 15.8}, 8, 0},
-};
-// clang-format on
+// number of frames the profiler overlay computes its percentiles over
+static constexpr std::size_t kProfilerWindow = 300;
+static constexpr int kProfilerOverlayY = 40;
+static constexpr int kProfilerOverlayLineHeight = 22;
+
+// how long to sleep waiting for input while the scene is unchanged, also bounds how stale the
+// profiler overlay gets
+static constexpr int kIdleTimeoutMs = 100;
+// entities may move at any time while connected, so do not wait longer than a server tick
+static constexpr int kNetworkIdleTimeoutMs = 16;
 }  // namespace
 
 struct Input {
@@ -67,6 +58,11 @@ struct Input {
   bool back;
   bool left;
   bool right;
+
+  bool toggleProfiler;
+
+  // the window contents were lost and need to be drawn again
+  bool exposed;
 };
 
 RayCasterRenderer* init() {
@@ -97,62 +93,14 @@ RayCasterRenderer* init() {
     return nullptr;
   }
 
-  TTF_Font* pFont = TTF_OpenFont(kFontPath.c_str(), 24);
+  TTF_Font* pFont = loadFont();
   if (!pFont) {
-    std::cout << "Could not load font '" << kFontPath << "': " << TTF_GetError() << std::endl;
     SDL_DestroyWindow(pWindow);
     return nullptr;
   }
 
-  return new RayCasterRenderer(pWindow, pFont, kScreenWidth, kScreenHeight, kTexWidth, kTexHeight);
-}
-
-SDL_Surface* loadImageFromFile(const std::string& filename, const SDL_PixelFormat& format) {
-  SDL_Surface* pSurface = nullptr;
-
-  SDL_Surface* pLoaded = IMG_Load(filename.c_str());
-  if (!pLoaded) {
-    std::cout << "Could not load texture '" << filename << "'" << std::endl;
-    return nullptr;
-  }
-
-  if (pLoaded->w != kTexWidth || pLoaded->h != kTexHeight) {
-    std::cout << "Invalid texture size for '" << filename << "', must be " << kTexWidth << " * "
-              << kTexHeight << std::endl;
-    SDL_FreeSurface(pLoaded);
-    return nullptr;
-  }
-
-  pSurface = SDL_ConvertSurface(pLoaded, &format, 0);
-  if (!pSurface) {
-    std::cout << "Could not optimize texture '" << filename
-              << "' to screen format: " << SDL_GetError() << std::endl;
-  }
-
-  SDL_FreeSurface(pLoaded);
-
-  return pSurface;
-}
-
-bool loadTextures(RayCasterRenderer& renderer) {
-  for (std::size_t i = 0; i < count_of(kTexturePaths); ++i) {
-    SDL_Surface* pTexture = loadImageFromFile(kTexturePaths[i], *renderer.getPixelFormat());
-    if (pTexture) {
-      renderer.addTexture(pTexture);
-    } else {
-      return false;
-    }
-  }
-  return true;
-}
-
-// Sort sprites from farthest to nearest
-void sortSprites(std::vector<Sprite>& sprites, const Vector2d& playerPos) {
-  for (Sprite& sprite : sprites) {
-    sprite.distance = (playerPos - sprite.pos).squaredNorm();
-  }
-  std::sort(sprites.begin(), sprites.end(),
-            [](const Sprite& lhs, const Sprite& rhs) { return lhs.distance > rhs.distance; });
+  return new RayCasterRenderer(pWindow, pFont, kScreenWidth, kScreenHeight, kTexWidth, kTexHeight,
+                               kRenderThreads);
 }
 
 void pollInput(Input& input) {
@@ -160,6 +108,11 @@ void pollInput(Input& input) {
   while (SDL_PollEvent(&event)) {
     if (event.type == SDL_QUIT) {
       input.quit = true;
+    } else if (event.type == SDL_WINDOWEVENT) {
+      if (event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+          event.window.event == SDL_WINDOWEVENT_RESTORED) {
+        input.exposed = true;
+      }
     } else {
       switch (event.key.keysym.sym) {
       case SDLK_ESCAPE:
@@ -190,6 +143,13 @@ void pollInput(Input& input) {
         break;
       }
 
+      case SDLK_F1: {
+        if (event.type == SDL_KEYDOWN) {
+          input.toggleProfiler = true;
+        }
+        break;
+      }
+
       default:
         break;
       }
@@ -197,7 +157,42 @@ void pollInput(Input& input) {
   }
 }
 
-int main() {
+void renderProfilerOverlay(const RayCasterRenderer& renderer, const Profiler& profiler) {
+  char lineBuffer[64];
+  int y = kProfilerOverlayY;
+  for (const Profiler::Summary& summary : profiler.summarize()) {
+    snprintf(lineBuffer, count_of(lineBuffer), "%-8s p50 %6.2f  p95 %6.2f  p99 %6.2f ms",
+             summary.name.c_str(), summary.p50Ms, summary.p95Ms, summary.p99Ms);
+    renderer.renderText(lineBuffer, 10, y, kTextColor);
+    y += kProfilerOverlayLineHeight;
+  }
+}
+
+int main(int argc, char** argv) {
+  // optional file to write the profiler summary to at exit, .json or .csv
+  std::string profileOutput;
+  // optional tile map file to play instead of the built-in map
+  std::string mapFile;
+  // optional potentially visible set for the map, written by mapgen --pvs
+  std::string visibilityFile;
+  // number of entities a local stand-in server simulates around the start, 0 for none
+  int localEntities = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--profile-out") && i + 1 < argc) {
+      profileOutput = argv[++i];
+    } else if (!std::strcmp(argv[i], "--map") && i + 1 < argc) {
+      mapFile = argv[++i];
+    } else if (!std::strcmp(argv[i], "--pvs") && i + 1 < argc) {
+      visibilityFile = argv[++i];
+    } else if (!std::strcmp(argv[i], "--local-server") && i + 1 < argc) {
+      localEntities = std::atoi(argv[++i]);
+    } else {
+      std::cout << "usage: spatialstein3d [--map FILE] [--pvs FILE] [--local-server ENTITIES]"
+                   " [--profile-out FILE.csv|FILE.json]"
+                << std::endl;
+      return -1;
+    }
+  }
 
   RayCasterRenderer* pRenderer = init();
   if (!pRenderer) {
@@ -216,29 +211,91 @@ int main() {
   pRenderer->setCeilingTextureIndex(6);
 
   WorldMap world;
+  if (!mapFile.empty() && !world.load(mapFile)) {
+    delete pRenderer;
+    SDL_Quit();
+    return -1;
+  }
+
+  SpriteGrid spriteGrid;
+  for (const Sprite& sprite : createDefaultSprites()) {
+    spriteGrid.insert(sprite);
+  }
+  // how far to the side sprites reach on screen, with some slack for rounding to pixels
+  const double spriteRadius = static_cast<double>(kScreenHeight) / kScreenWidth * kFov + 0.5;
+  std::vector<SpriteGrid::SpriteId> visibleSprites;
+  SpriteOrder spriteOrder;
+
+  // replicated entities join the sprites of the map
+  EntityView entities{spriteGrid};
+  // only entities that may come into view are sent
+  InterestTracker interest{kSpriteDrawDistance, spriteRadius};
+  std::vector<EntityOp> ops;
+  std::unique_ptr<NetworkThread> pNetwork;
+  if (localEntities > 0) {
+    std::unique_ptr<LocalServer> pServer{
+        new LocalServer(mapFile, kStartPos, localEntities, kLocalServerSeed)};
+    if (!pServer->valid()) {
+      delete pRenderer;
+      SDL_Quit();
+      return -1;
+    }
+    pNetwork.reset(new NetworkThread(std::move(pServer)));
+  }
+
+  // the built-in map is small enough to find its set at startup
+  VisibilitySet visibility;
+  if (!visibilityFile.empty()) {
+    if (!visibility.load(visibilityFile, world)) {
+      delete pRenderer;
+      SDL_Quit();
+      return -1;
+    }
+    spriteGrid.setVisibilitySet(&visibility);
+  } else if (mapFile.empty()) {
+    visibility.build(world);
+    spriteGrid.setVisibilitySet(&visibility);
+  }
 
   Camera camera{kStartDir, kFov};
   Player player{kStartPos, kStartDir, camera};
 
-  Uint32 time = 0;
-  Uint32 oldTime = 0;
+  Profiler profiler{kProfilerWindow};
+  pRenderer->setProfiler(&profiler);
+  bool showProfiler = false;
+
+  const double counterFrequency = static_cast<double>(SDL_GetPerformanceFrequency());
+  Uint64 time = SDL_GetPerformanceCounter();
+  Uint64 oldTime = 0;
+  // unlike the frame time, the entity view's clock keeps running while waiting for input
+  Uint64 entityTime = time;
 
   Input input{};
 
-  char fpsBuffer[15];
+  char fpsBuffer[15] = "";
 
   bool quit = false;
   while (!quit) {
     oldTime = time;
-    time = SDL_GetTicks();
-    double frameTime = static_cast<double>(time - oldTime) / 1000.0;
-    double fps = 1.0 / frameTime;
-    snprintf(fpsBuffer, count_of(fpsBuffer), "FPS: %.2f", fps);
+    time = SDL_GetPerformanceCounter();
+    double frameTime = static_cast<double>(time - oldTime) / counterFrequency;
+    profiler.addSample("frame", frameTime * 1000.0);
 
     double moveSpeed = frameTime * kMoveSpeed;
     double rotSpeed = frameTime * kTurnSpeed;
 
-    pollInput(input);
+    {
+      ScopedTimer timer{&profiler, "input"};
+      pollInput(input);
+    }
+    if (input.toggleProfiler) {
+      showProfiler = !showProfiler;
+      input.toggleProfiler = false;
+    }
+    if (input.exposed) {
+      pRenderer->invalidate();
+      input.exposed = false;
+    }
     if (input.quit) {
       quit = true;
     } else {
@@ -268,11 +325,55 @@ int main() {
       }
     }
 
-    sortSprites(kSprites, player.pos());
+    {
+      // streams in the map around the player, newly loaded chunks change what is visible
+      ScopedTimer timer{&profiler, "world"};
+      if (world.update(player.pos())) {
+        pRenderer->invalidate();
+      }
+    }
+    if (pNetwork) {
+      ScopedTimer timer{&profiler, "network"};
+      pNetwork->send(PlayerUpdate{player.pos(), player.dir()});
+      if (interest.update(player)) {
+        pNetwork->setInterest(interest.region());
+      }
+      pNetwork->receive(ops);
+      entities.apply(ops);
+      ops.clear();
+      entities.advance(static_cast<double>(time - entityTime) / counterFrequency);
+      entityTime = time;
+    }
+    {
+      ScopedTimer timer{&profiler, "cull"};
+      visibleSprites.clear();
+      spriteGrid.query(player, kSpriteDrawDistance, spriteRadius, visibleSprites);
+      spriteOrder.update(spriteGrid, visibleSprites, player.pos());
+    }
 
-    pRenderer->render(world, player, kSprites);
-    pRenderer->renderText(fpsBuffer, 10, 10, kTextColor);
+    const bool sceneDrawn = pRenderer->render(world, player, spriteOrder.sprites());
+    if (sceneDrawn) {
+      snprintf(fpsBuffer, count_of(fpsBuffer), "FPS: %.2f", 1.0 / frameTime);
+    }
+    {
+      ScopedTimer timer{&profiler, "text"};
+      pRenderer->renderText(fpsBuffer, 10, 10, kTextColor);
+      if (showProfiler) {
+        renderProfilerOverlay(*pRenderer, profiler);
+      }
+    }
     pRenderer->present();
+
+    if (!sceneDrawn) {
+      // nothing moved, so sleep until there is input instead of presenting identical frames. The
+      // wait does not count towards the next frame's movement.
+      SDL_WaitEventTimeout(nullptr, pNetwork ? kNetworkIdleTimeoutMs : kIdleTimeoutMs);
+      time = SDL_GetPerformanceCounter();
+    }
+  }
+
+  if (!profileOutput.empty()) {
+    profiler.exportToFile(profileOutput);
   }
 
   delete pRenderer;
@@ -0,0 +1,108 @@
+#include "mappedfile.hpp"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    std::cout << "Could not open '" << filename << "': error " << GetLastError() << std::endl;
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    std::cout << "Could not map '" << filename << "': file is empty" << std::endl;
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  void* pData = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!pData) {
+    std::cout << "Could not map '" << filename << "': error " << GetLastError() << std::endl;
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return false;
+  }
+
+  m_fileHandle = file;
+  m_mappingHandle = mapping;
+  m_pData = static_cast<const std::uint8_t*>(pData);
+  m_size = static_cast<std::size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_pData) {
+    UnmapViewOfFile(m_pData);
+    CloseHandle(m_mappingHandle);
+    CloseHandle(m_fileHandle);
+  }
+  m_pData = nullptr;
+  m_size = 0;
+  m_fileHandle = nullptr;
+  m_mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "Could not open '" << filename << "'" << std::endl;
+    return false;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    std::cout << "Could not map '" << filename << "': file is empty" << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  const std::size_t size = static_cast<std::size_t>(status.st_size);
+  void* pData = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+  if (pData == MAP_FAILED) {
+    std::cout << "Could not map '" << filename << "'" << std::endl;
+    return false;
+  }
+
+  m_pData = static_cast<const std::uint8_t*>(pData);
+  m_size = size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_pData) {
+    munmap(const_cast<std::uint8_t*>(m_pData), m_size);
+  }
+  m_pData = nullptr;
+  m_size = 0;
+}
+
+#endif
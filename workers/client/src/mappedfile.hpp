@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A whole file mapped read-only into memory. Pages are only read from disk when first touched, so
+// opening a large file is cheap.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Maps `filename`, replacing any previously mapped file. Returns false if the file could not be
+  // opened or is empty.
+  bool open(const std::string& filename);
+  void close();
+
+  const std::uint8_t* data() const {
+    return m_pData;
+  }
+
+  std::size_t size() const {
+    return m_size;
+  }
+
+private:
+  const std::uint8_t* m_pData = nullptr;
+  std::size_t m_size = 0;
+#ifdef _WIN32
+  void* m_fileHandle = nullptr;
+  void* m_mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,105 @@
+#include "networkthread.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+static constexpr std::chrono::microseconds kTickInterval{1000000 / NetworkThread::kTickRate};
+// a few frames' worth of updates for thousands of entities
+static constexpr std::size_t kIncomingCapacity = 1 << 16;
+static constexpr std::size_t kOutgoingCapacity = 64;
+static constexpr std::size_t kInterestCapacity = 8;
+}  // namespace
+
+NetworkThread::NetworkThread(std::unique_ptr<LocalServer> pServer, bool synchronous)
+: m_pServer(std::move(pServer))
+, m_incoming(kIncomingCapacity)
+, m_outgoing(kOutgoingCapacity)
+, m_interest(kInterestCapacity) {
+  if (!synchronous) {
+    m_thread = std::thread(&NetworkThread::ioLoop, this);
+  }
+}
+
+NetworkThread::~NetworkThread() {
+  if (m_thread.joinable()) {
+    m_quit.store(true, std::memory_order_relaxed);
+    m_thread.join();
+  }
+}
+
+void NetworkThread::receive(std::vector<EntityOp>& ops) {
+  if (m_hasPendingInterest) {
+    m_hasPendingInterest = !m_interest.tryPush(m_pendingInterest);
+  }
+
+  EntityOp op;
+  while (m_incoming.tryPop(op)) {
+    ops.push_back(op);
+  }
+}
+
+void NetworkThread::send(const PlayerUpdate& update) {
+  m_outgoing.tryPush(update);
+}
+
+void NetworkThread::setInterest(const InterestRegion& region) {
+  // unlike player updates the newest region must not be dropped, it is only sent on changes
+  m_pendingInterest = region;
+  m_hasPendingInterest = !m_interest.tryPush(m_pendingInterest);
+}
+
+void NetworkThread::tick() {
+  step(1.0 / kTickRate);
+}
+
+void NetworkThread::ioLoop() {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point lastStep = Clock::now();
+  Clock::time_point nextTick = lastStep;
+
+  while (!m_quit.load(std::memory_order_relaxed)) {
+    const Clock::time_point now = Clock::now();
+    step(std::chrono::duration<double>(now - lastStep).count());
+    lastStep = now;
+
+    // after a stall the next tick starts from now instead of catching up in a burst
+    nextTick = std::max(nextTick + kTickInterval, now);
+    std::this_thread::sleep_until(nextTick);
+  }
+}
+
+void NetworkThread::step(double dt) {
+  // the game loop queues a state every frame, each one supersedes the ones before
+  while (m_outgoing.tryPop(m_lastUpdate)) {
+    m_hasLastUpdate = true;
+  }
+
+  // encoded every tick even without a new state, so the exact state reaches the server in the end
+  m_sendBuffer.clear();
+  if (m_hasLastUpdate && m_playerEncoder.encode(m_lastUpdate, m_sendBuffer)) {
+    m_pServer->receive(m_sendBuffer.data(), m_sendBuffer.size());
+    // a remote server would send the acknowledgement back with its ops
+    if (m_pServer->hasAcknowledgedPlayerUpdate()) {
+      m_playerEncoder.acknowledge(m_pServer->acknowledgedPlayerUpdate());
+    }
+  }
+
+  InterestRegion region;
+  bool hasRegion = false;
+  while (m_interest.tryPop(region)) {
+    hasRegion = true;
+  }
+  if (hasRegion) {
+    m_pServer->setInterest(region);
+  }
+
+  m_pServer->update(dt, m_backlog);
+
+  // ops have to arrive in order and none may be lost, so whatever the game loop has no room for
+  // yet waits for the next tick
+  std::size_t pushed = 0;
+  while (pushed < m_backlog.size() && m_incoming.tryPush(m_backlog[pushed])) {
+    ++pushed;
+  }
+  m_backlog.erase(m_backlog.begin(), m_backlog.begin() + pushed);
+}
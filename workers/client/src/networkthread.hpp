@@ -0,0 +1,69 @@
+#pragma once
+
+#include "entityop.hpp"
+#include "interestregion.hpp"
+#include "localserver.hpp"
+#include "playerupdate.hpp"
+#include "spscqueue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Talks to the server on a thread of its own, so waiting for the network and encoding or decoding
+// messages never happen inside a frame. The game loop hands over data through bounded lock-free
+// queues and never waits for this thread.
+class NetworkThread {
+public:
+  // how many times per second the server is stepped and the queues are serviced
+  static constexpr int kTickRate = 60;
+
+  // In synchronous mode there is no thread and the server only advances when `tick` is called, by
+  // a fixed 1 / kTickRate seconds each time, so runs can be reproduced exactly
+  explicit NetworkThread(std::unique_ptr<LocalServer> pServer, bool synchronous = false);
+  ~NetworkThread();
+
+  NetworkThread(const NetworkThread&) = delete;
+  NetworkThread& operator=(const NetworkThread&) = delete;
+
+  // Appends the ops received since the last call to `ops`. Game loop only.
+  void receive(std::vector<EntityOp>& ops);
+
+  // Queues the local player's state for sending. While the queue is full updates are dropped,
+  // the next one supersedes them anyway. Only the newest state is sent each tick, and only if it
+  // changed noticeably. Game loop only.
+  void send(const PlayerUpdate& update);
+
+  // Sends the region the client wants entities from. A region that does not fit into the queue
+  // is retried on the next call to `receive`. Game loop only.
+  void setInterest(const InterestRegion& region);
+
+  // Synchronous mode only: sends what was queued, steps the server by one tick and queues its ops
+  // for `receive`. Game loop only.
+  void tick();
+
+private:
+  void ioLoop();
+  // One tick of the I/O side, stepping the server by `dt` seconds
+  void step(double dt);
+
+  // game loop only
+  InterestRegion m_pendingInterest;
+  bool m_hasPendingInterest = false;
+
+  // owned by the I/O thread from construction on, or by the game loop in synchronous mode
+  std::unique_ptr<LocalServer> m_pServer;
+  // ops that did not fit into m_incoming yet, in order
+  std::vector<EntityOp> m_backlog;
+  PlayerUpdate m_lastUpdate;
+  bool m_hasLastUpdate = false;
+  PlayerUpdateEncoder m_playerEncoder;
+  std::vector<std::uint8_t> m_sendBuffer;
+
+  SpscQueue<EntityOp> m_incoming;
+  SpscQueue<PlayerUpdate> m_outgoing;
+  SpscQueue<InterestRegion> m_interest;
+  std::atomic<bool> m_quit{false};
+  std::thread m_thread;
+};
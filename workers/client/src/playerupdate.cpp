@@ -0,0 +1,183 @@
+#include "playerupdate.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace Eigen;
+
+namespace {
+static constexpr double kPi = 3.14159265358979323846;
+static constexpr double kAngleScale = 65536 / (2 * kPi);
+// below these changes to the last sent state nothing is sent: 1/64 cell and about half a degree
+static constexpr std::int64_t kPositionThreshold =
+    static_cast<std::int64_t>(QuantizedPlayerUpdate::kPositionScale / 64);
+static constexpr int kAngleThreshold = 96;
+// how often the exact state is sent anyway while the server does not have it, which also
+// repairs lost messages
+static constexpr int kRefreshInterval = 30;
+
+static constexpr std::uint8_t kDeltaFlag = 1;
+static constexpr std::size_t kMaxVarintSize = 10;
+
+// `a - b` for sequence numbers and angles, which wrap around
+int wrappedDiff(std::uint16_t a, std::uint16_t b) {
+  return static_cast<std::int16_t>(static_cast<std::uint16_t>(a - b));
+}
+
+void writeBytes(std::uint64_t value, int count, std::vector<std::uint8_t>& out) {
+  for (int i = 0; i < count; ++i) {
+    out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+}
+
+void writeVarint(std::int64_t value, std::vector<std::uint8_t>& out) {
+  std::uint64_t zigzag = (static_cast<std::uint64_t>(value) << 1) ^
+      static_cast<std::uint64_t>(value >> 63);
+  while (zigzag >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(zigzag | 0x80));
+    zigzag >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(zigzag));
+}
+
+// Readers advance `offset` and return false if the message ends early
+bool readBytes(const std::uint8_t* pData, std::size_t size, std::size_t& offset, int count,
+               std::uint64_t& value) {
+  if (size - offset < static_cast<std::size_t>(count)) {
+    return false;
+  }
+  value = 0;
+  for (int i = 0; i < count; ++i) {
+    value |= static_cast<std::uint64_t>(pData[offset++]) << (8 * i);
+  }
+  return true;
+}
+
+bool readVarint(const std::uint8_t* pData, std::size_t size, std::size_t& offset,
+                std::int64_t& value) {
+  std::uint64_t zigzag = 0;
+  for (std::size_t i = 0; i < kMaxVarintSize && offset < size; ++i) {
+    const std::uint8_t byte = pData[offset++];
+    zigzag |= static_cast<std::uint64_t>(byte & 0x7f) << (7 * i);
+    if (!(byte & 0x80)) {
+      value = static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1);
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+QuantizedPlayerUpdate QuantizedPlayerUpdate::quantize(const PlayerUpdate& update) {
+  const auto fixed = [](double value) {
+    return static_cast<std::uint32_t>(
+        std::min(std::max(std::round(value * kPositionScale), 0.0), 4294967295.0));
+  };
+  const double angle = std::atan2(update.dir.y(), update.dir.x());
+  return QuantizedPlayerUpdate{fixed(update.pos.x()), fixed(update.pos.y()),
+                               static_cast<std::uint16_t>(std::lround(angle * kAngleScale))};
+}
+
+PlayerUpdate QuantizedPlayerUpdate::dequantize() const {
+  const double radians = angle / kAngleScale;
+  return PlayerUpdate{Vector2d{x / kPositionScale, y / kPositionScale},
+                      Vector2d{std::cos(radians), std::sin(radians)}};
+}
+
+bool PlayerUpdateEncoder::encode(const PlayerUpdate& update, std::vector<std::uint8_t>& out) {
+  const QuantizedPlayerUpdate state = QuantizedPlayerUpdate::quantize(update);
+  ++m_callsSinceSend;
+  if (m_hasSent) {
+    const bool changed =
+        std::abs(static_cast<std::int64_t>(state.x) - m_sent.x) > kPositionThreshold ||
+        std::abs(static_cast<std::int64_t>(state.y) - m_sent.y) > kPositionThreshold ||
+        std::abs(wrappedDiff(state.angle, m_sent.angle)) > kAngleThreshold;
+    const bool serverCurrent = m_hasAcked && m_acked == state;
+    if (!changed && (serverCurrent || m_callsSinceSend < kRefreshInterval)) {
+      return false;
+    }
+  }
+
+  const std::uint16_t sequence = m_sequence++;
+  m_history[sequence & kHistoryMask] = state;
+  m_sent = state;
+  m_hasSent = true;
+  m_callsSinceSend = 0;
+
+  // the decoder only remembers the last kHistorySize states
+  const bool delta = m_hasAcked && wrappedDiff(sequence, m_ackedSequence) < kHistorySize;
+  out.push_back(delta ? kDeltaFlag : 0);
+  writeBytes(sequence, 2, out);
+  if (delta) {
+    out.push_back(static_cast<std::uint8_t>(sequence - m_ackedSequence));
+    writeVarint(static_cast<std::int64_t>(state.x) - m_acked.x, out);
+    writeVarint(static_cast<std::int64_t>(state.y) - m_acked.y, out);
+    writeVarint(wrappedDiff(state.angle, m_acked.angle), out);
+  } else {
+    writeBytes(state.x, 4, out);
+    writeBytes(state.y, 4, out);
+    writeBytes(state.angle, 2, out);
+  }
+  return true;
+}
+
+void PlayerUpdateEncoder::acknowledge(std::uint16_t sequence) {
+  const int age = wrappedDiff(m_sequence, sequence);
+  if (!m_hasSent || age <= 0 || age > kHistorySize ||
+      (m_hasAcked && wrappedDiff(sequence, m_ackedSequence) <= 0)) {
+    return;
+  }
+  m_acked = m_history[sequence & kHistoryMask];
+  m_ackedSequence = sequence;
+  m_hasAcked = true;
+}
+
+std::size_t PlayerUpdateDecoder::decode(const std::uint8_t* pData, std::size_t size,
+                                        PlayerUpdate& update) {
+  std::size_t offset = 0;
+  std::uint64_t flags, sequence;
+  if (!readBytes(pData, size, offset, 1, flags) || !readBytes(pData, size, offset, 2, sequence)) {
+    return 0;
+  }
+
+  QuantizedPlayerUpdate state;
+  if (flags & kDeltaFlag) {
+    std::uint64_t back;
+    std::int64_t dx, dy, dAngle;
+    if (!readBytes(pData, size, offset, 1, back) || !readVarint(pData, size, offset, dx) ||
+        !readVarint(pData, size, offset, dy) || !readVarint(pData, size, offset, dAngle)) {
+      return 0;
+    }
+    const auto baseline = static_cast<std::uint16_t>(sequence - back);
+    const int index = baseline & kHistoryMask;
+    // without its baseline the message is skipped, it has been read to its end already
+    if (!m_historyValid[index] || m_historySequence[index] != baseline) {
+      return offset;
+    }
+    state.x = static_cast<std::uint32_t>(m_history[index].x + dx);
+    state.y = static_cast<std::uint32_t>(m_history[index].y + dy);
+    state.angle = static_cast<std::uint16_t>(m_history[index].angle + dAngle);
+  } else {
+    std::uint64_t x, y, angle;
+    if (!readBytes(pData, size, offset, 4, x) || !readBytes(pData, size, offset, 4, y) ||
+        !readBytes(pData, size, offset, 2, angle)) {
+      return 0;
+    }
+    state.x = static_cast<std::uint32_t>(x);
+    state.y = static_cast<std::uint32_t>(y);
+    state.angle = static_cast<std::uint16_t>(angle);
+  }
+
+  const auto current = static_cast<std::uint16_t>(sequence);
+  if (m_hasNewest && wrappedDiff(current, m_newest) <= 0) {
+    return offset;
+  }
+  const int index = current & kHistoryMask;
+  m_history[index] = state;
+  m_historySequence[index] = current;
+  m_historyValid[index] = true;
+  m_newest = current;
+  m_hasNewest = true;
+  update = state.dequantize();
+  return offset;
+}
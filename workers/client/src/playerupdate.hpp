@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The state of the local player that is sent to the runtime
+struct PlayerUpdate {
+  Eigen::Vector2d pos;
+  Eigen::Vector2d dir;
+};
+
+// A player update as it is sent: the position in fixed point relative to the map origin, in
+// 1/kPositionScale cells, and the facing as a 16 bit angle
+struct QuantizedPlayerUpdate {
+  static constexpr double kPositionScale = 1024;
+
+  std::uint32_t x;
+  std::uint32_t y;
+  std::uint16_t angle;
+
+  static QuantizedPlayerUpdate quantize(const PlayerUpdate& update);
+  PlayerUpdate dequantize() const;
+
+  bool operator==(const QuantizedPlayerUpdate& other) const {
+    return x == other.x && y == other.y && angle == other.angle;
+  }
+};
+
+// Every message has a flags byte and a 16 bit sequence number. A full message then has the
+// quantized state, 10 bytes. A delta message has the distance back to the sequence number of its
+// baseline in one byte, then the differences to the last acknowledged state as zigzag varints, so
+// it is at least 7 bytes. A player walking at 5 cells per second moves further than the threshold
+// every 60 Hz tick and sends a message each time, 8 to 10 bytes depending on how long the
+// acknowledgements take; standing still it sends nothing.
+class PlayerUpdateEncoder {
+public:
+  // Appends a message for `update` to `out` unless the server already has a state close enough to
+  // it. Returns whether a message was appended. Meant to be called at a steady rate.
+  bool encode(const PlayerUpdate& update, std::vector<std::uint8_t>& out);
+
+  // The server has decoded the message with the given sequence number, later messages are delta
+  // encoded against it
+  void acknowledge(std::uint16_t sequence);
+
+  // States that have been sent and may still be acknowledged
+  static constexpr int kHistorySize = 32;
+
+private:
+  static constexpr int kHistoryMask = kHistorySize - 1;
+  static_assert((kHistorySize & kHistoryMask) == 0, "the history size must be a power of two");
+
+  QuantizedPlayerUpdate m_history[kHistorySize];
+  QuantizedPlayerUpdate m_sent;
+  QuantizedPlayerUpdate m_acked;
+  std::uint16_t m_sequence = 0;
+  std::uint16_t m_ackedSequence = 0;
+  bool m_hasSent = false;
+  bool m_hasAcked = false;
+  int m_callsSinceSend = 0;
+};
+
+class PlayerUpdateDecoder {
+public:
+  // Decodes the message at the start of `pData` and returns its length, or 0 if it is malformed.
+  // `update` is only set if the message is newer than every message decoded before and its
+  // baseline is known.
+  std::size_t decode(const std::uint8_t* pData, std::size_t size, PlayerUpdate& update);
+
+  // The sequence number to acknowledge to the encoder, valid once anything has been decoded
+  bool hasAcknowledged() const {
+    return m_hasNewest;
+  }
+  std::uint16_t acknowledged() const {
+    return m_newest;
+  }
+
+private:
+  static constexpr int kHistoryMask = PlayerUpdateEncoder::kHistorySize - 1;
+
+  // decoded states by sequence number, as possible baselines
+  QuantizedPlayerUpdate m_history[PlayerUpdateEncoder::kHistorySize] = {};
+  std::uint16_t m_historySequence[PlayerUpdateEncoder::kHistorySize] = {};
+  bool m_historyValid[PlayerUpdateEncoder::kHistorySize] = {};
+  std::uint16_t m_newest = 0;
+  bool m_hasNewest = false;
+};
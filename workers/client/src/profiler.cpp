@@ -0,0 +1,99 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+// nearest-rank percentile of an already sorted range
+double percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const std::size_t rank = static_cast<std::size_t>(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[rank];
+}
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+  return value.size() >= suffix.size() &&
+      value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}  // namespace
+
+Profiler::Profiler(std::size_t windowSize) : m_windowSize(std::max<std::size_t>(1, windowSize)) {}
+
+void Profiler::addSample(const char* pSection, double ms) {
+  Section& section = findSection(pSection);
+  if (section.window.size() < m_windowSize) {
+    section.window.push_back(ms);
+  } else {
+    section.window[section.nextSample] = ms;
+  }
+  section.nextSample = (section.nextSample + 1) % m_windowSize;
+  ++section.sampleCount;
+  section.totalMs += ms;
+  section.maxMs = std::max(section.maxMs, ms);
+}
+
+std::vector<Profiler::Summary> Profiler::summarize() const {
+  std::vector<Summary> summaries;
+  summaries.reserve(m_sections.size());
+
+  std::vector<double> sorted;
+  for (const Section& section : m_sections) {
+    sorted = section.window;
+    std::sort(sorted.begin(), sorted.end());
+
+    Summary summary;
+    summary.name = section.name;
+    summary.p50Ms = percentile(sorted, 0.50);
+    summary.p95Ms = percentile(sorted, 0.95);
+    summary.p99Ms = percentile(sorted, 0.99);
+    summary.meanMs = section.sampleCount ? section.totalMs / section.sampleCount : 0;
+    summary.maxMs = section.maxMs;
+    summary.sampleCount = section.sampleCount;
+    summaries.push_back(summary);
+  }
+  return summaries;
+}
+
+bool Profiler::exportToFile(const std::string& filename) const {
+  std::ofstream file{filename};
+  if (!file) {
+    std::cout << "Could not open profile output '" << filename << "'" << std::endl;
+    return false;
+  }
+
+  const std::vector<Summary> summaries = summarize();
+  if (endsWith(filename, ".json")) {
+    file << "{\n  \"sections\": [";
+    for (std::size_t i = 0; i < summaries.size(); ++i) {
+      const Summary& summary = summaries[i];
+      file << (i ? ",\n" : "\n") << "    {\"name\": \"" << summary.name
+           << "\", \"p50_ms\": " << summary.p50Ms << ", \"p95_ms\": " << summary.p95Ms
+           << ", \"p99_ms\": " << summary.p99Ms << ", \"mean_ms\": " << summary.meanMs
+           << ", \"max_ms\": " << summary.maxMs << ", \"samples\": " << summary.sampleCount
+           << "}";
+    }
+    file << "\n  ]\n}\n";
+  } else {
+    file << "section,p50_ms,p95_ms,p99_ms,mean_ms,max_ms,samples\n";
+    for (const Summary& summary : summaries) {
+      file << summary.name << "," << summary.p50Ms << "," << summary.p95Ms << ","
+           << summary.p99Ms << "," << summary.meanMs << "," << summary.maxMs << ","
+           << summary.sampleCount << "\n";
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+Profiler::Section& Profiler::findSection(const char* pName) {
+  for (Section& section : m_sections) {
+    if (section.name == pName) {
+      return section;
+    }
+  }
+  m_sections.emplace_back();
+  m_sections.back().name = pName;
+  m_sections.back().window.reserve(m_windowSize);
+  return m_sections.back();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Collects per-section timings over a rolling window of recent samples. Sections are identified by
+// name and created on first use; all calls must come from the same thread.
+class Profiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Summary {
+    std::string name;
+    // percentiles over the rolling window, in milliseconds
+    double p50Ms;
+    double p95Ms;
+    double p99Ms;
+    // over the whole lifetime of the profiler
+    double meanMs;
+    double maxMs;
+    std::size_t sampleCount;
+  };
+
+  explicit Profiler(std::size_t windowSize);
+
+  void addSample(const char* pSection, double ms);
+
+  // Summaries for all sections in the order they were first seen
+  std::vector<Summary> summarize() const;
+
+  // Writes the current summaries as CSV or JSON, chosen by the file extension
+  bool exportToFile(const std::string& filename) const;
+
+private:
+  struct Section {
+    std::string name;
+    std::vector<double> window;
+    std::size_t nextSample = 0;
+    std::size_t sampleCount = 0;
+    double totalMs = 0;
+    double maxMs = 0;
+  };
+
+  Section& findSection(const char* pName);
+
+  std::size_t m_windowSize;
+  std::vector<Section> m_sections;
+};
+
+// Times its own lifetime and reports it to a profiler. A null profiler turns it into a no-op.
+class ScopedTimer {
+public:
+  ScopedTimer(Profiler* pProfiler, const char* pSection)
+  : m_pProfiler(pProfiler), m_pSection(pSection) {
+    if (m_pProfiler) {
+      m_start = Profiler::Clock::now();
+    }
+  }
+
+  ~ScopedTimer() {
+    if (m_pProfiler) {
+      const std::chrono::duration<double, std::milli> elapsed = Profiler::Clock::now() - m_start;
+      m_pProfiler->addSample(m_pSection, elapsed.count());
+    }
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+  Profiler* m_pProfiler;
+  const char* m_pSection;
+  Profiler::Clock::time_point m_start;
+};
@@ -0,0 +1,307 @@
+#include "raycast.hpp"
+#include "worldmap.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace Eigen;
+
+namespace {
+constexpr int kFixedShift = 16;
+constexpr std::int32_t kFixedOne = 1 << kFixedShift;
+constexpr std::int32_t kFixedFractionMask = kFixedOne - 1;
+
+// Largest delta distance we represent. Two of them still fit an int32, which is all the DDA needs
+// as long as a wall is hit within 32767 cells.
+constexpr std::int32_t kMaxFixedDeltaDist = 0x3fffffff;
+
+// a region shift covering every cell of the map, rays that start in it never look for empty space
+// again unless they step off the map into the border
+constexpr int kNoLeapShift = 30;
+
+inline std::int32_t toFixed(double value) {
+  return static_cast<std::int32_t>(std::floor(value * kFixedOne));
+}
+
+inline std::int32_t fixedDeltaDist(double rayDir) {
+  const double deltaDist = std::abs(1 / rayDir) * kFixedOne;
+  return deltaDist < kMaxFixedDeltaDist ? static_cast<std::int32_t>(deltaDist)
+                                        : kMaxFixedDeltaDist;
+}
+
+inline std::int32_t fixedMul(std::int32_t lhs, std::int32_t rhs) {
+  return static_cast<std::int32_t>((static_cast<std::int64_t>(lhs) * rhs) >> kFixedShift);
+}
+
+// Number of cells the DDA has to step along one axis to leave the aligned square of 2^shift cells
+// that contains `map`
+inline int stepsToLeave(int map, int step, int shift) {
+  const int regionStart = map & ~((1 << shift) - 1);
+  return step > 0 ? regionStart + (1 << shift) - map : map - regionStart + 1;
+}
+
+// Number of grid boundaries a ray crosses along one axis within `distance` of the next boundary on
+// that axis, at most `limit`. Boundaries are 1 / absDir apart. Boundaries exactly at `distance`
+// only count if `inclusive`.
+inline int countBoundaries(double distance, double absDir, int limit, bool inclusive) {
+  if (distance < 0 || (distance == 0 && !inclusive)) {
+    return 0;
+  }
+  const double boundaries = distance * absDir;
+  if (!(boundaries < limit)) {
+    return limit;
+  }
+  const int whole = static_cast<int>(boundaries);
+  return inclusive || whole == boundaries ? whole + inclusive : whole + 1;
+}
+
+// Moves the DDA of a ray inside an empty aligned square of 2^shift cells to the first cell past
+// the square in one go. The ray leaves through the side whose boundary comes first, having crossed
+// every boundary of the other axis before that. Returns false without moving if the exits cannot
+// be compared, which happens for rays exactly along an axis through a cell corner.
+inline bool leapEmptyRegion(int shift, const Vector2d& rayDir, const Vector2d& deltaDist, int stepX,
+                            int stepY, Vector2i& map, Vector2d& sideDist, bool& sideHit) {
+  const int stepsX = stepsToLeave(map.x(), stepX, shift);
+  const int stepsY = stepsToLeave(map.y(), stepY, shift);
+  // axis parallel rays have infinite deltas, which must not be multiplied by zero
+  const double exitX = stepsX > 1 ? sideDist.x() + (stepsX - 1) * deltaDist.x() : sideDist.x();
+  const double exitY = stepsY > 1 ? sideDist.y() + (stepsY - 1) * deltaDist.y() : sideDist.y();
+
+  if (exitX <= exitY) {
+    const int crossedY =
+        countBoundaries(exitX - sideDist.y(), std::abs(rayDir.y()), stepsY - 1, false);
+    map.x() += stepsX * stepX;
+    sideDist.x() = exitX + deltaDist.x();
+    if (crossedY) {
+      map.y() += crossedY * stepY;
+      sideDist.y() += crossedY * deltaDist.y();
+    }
+    sideHit = false;
+    return true;
+  }
+  if (exitY < exitX) {
+    const int crossedX =
+        countBoundaries(exitY - sideDist.x(), std::abs(rayDir.x()), stepsX - 1, true);
+    map.y() += stepsY * stepY;
+    sideDist.y() = exitY + deltaDist.y();
+    if (crossedX) {
+      map.x() += crossedX * stepX;
+      sideDist.x() += crossedX * deltaDist.x();
+    }
+    sideHit = true;
+    return true;
+  }
+  return false;
+}
+
+// Same as `leapEmptyRegion` for the fixed point DDA, where it is exact as every step adds the
+// same integer
+inline void leapEmptyRegionFixed(int shift, std::int32_t deltaDistX, std::int32_t deltaDistY,
+                                 int stepX, int stepY, int& mapX, int& mapY,
+                                 std::int32_t& sideDistX, std::int32_t& sideDistY, bool& sideHit) {
+  const int stepsX = stepsToLeave(mapX, stepX, shift);
+  const int stepsY = stepsToLeave(mapY, stepY, shift);
+  const std::int64_t exitX = sideDistX + static_cast<std::int64_t>(stepsX - 1) * deltaDistX;
+  const std::int64_t exitY = sideDistY + static_cast<std::int64_t>(stepsY - 1) * deltaDistY;
+
+  if (exitX <= exitY) {
+    const int crossedY = exitX > sideDistY
+        ? static_cast<int>(std::min<std::int64_t>(
+              stepsY - 1, (exitX - sideDistY + deltaDistY - 1) / deltaDistY))
+        : 0;
+    mapX += stepsX * stepX;
+    sideDistX = static_cast<std::int32_t>(exitX + deltaDistX);
+    mapY += crossedY * stepY;
+    sideDistY += crossedY * deltaDistY;
+    sideHit = false;
+  } else {
+    const int crossedX = sideDistX <= exitY
+        ? static_cast<int>(
+              std::min<std::int64_t>(stepsX - 1, (exitY - sideDistX) / deltaDistX + 1))
+        : 0;
+    mapY += stepsY * stepY;
+    sideDistY = static_cast<std::int32_t>(exitY + deltaDistY);
+    mapX += crossedX * stepX;
+    sideDistX += crossedX * deltaDistX;
+    sideHit = true;
+  }
+}
+}  // namespace
+
+RaySetup setupRay(const Vector2d& rayDir) {
+  RaySetup ray;
+  ray.dir = rayDir;
+
+  // potential div/0 is safe as infinity will be correctly handled
+  ray.deltaDist = Vector2d{std::abs(1 / rayDir.x()), std::abs(1 / rayDir.y())};
+
+  ray.stepX = rayDir.x() < 0 ? -1 : 1;
+  ray.stepY = rayDir.y() < 0 ? -1 : 1;
+
+  ray.fixedDirX = toFixed(rayDir.x());
+  ray.fixedDirY = toFixed(rayDir.y());
+  ray.fixedDeltaDistX = fixedDeltaDist(rayDir.x());
+  ray.fixedDeltaDistY = fixedDeltaDist(rayDir.y());
+  return ray;
+}
+
+WallHit castRay(const WorldMap& world, const Vector2d& pos, const RaySetup& ray,
+                int screenHeight, int texWidth) {
+  WallHit hit;
+
+  const Vector2d& rayDir = ray.dir;
+  const Vector2d& deltaDist = ray.deltaDist;
+  const int stepX = ray.stepX;
+  const int stepY = ray.stepY;
+
+  // which cell of the map we're in
+  hit.map = pos.cast<int>();
+
+  // length of ray from current position to next x or y side
+  Vector2d sideDist;
+  if (stepX < 0) {
+    sideDist.x() = (pos.x() - hit.map.x()) * deltaDist.x();
+  } else {
+    sideDist.x() = (hit.map.x() + 1.0 - pos.x()) * deltaDist.x();
+  }
+  if (stepY < 0) {
+    sideDist.y() = (pos.y() - hit.map.y()) * deltaDist.y();
+  } else {
+    sideDist.y() = (hit.map.y() + 1.0 - pos.y()) * deltaDist.y();
+  }
+
+  // the region last found to contain walls, no need to look for empty space while inside it.
+  // Without empty regions worth leaping over the whole map is one such region.
+  int wallRegionShift = 0;
+  int wallRegionX = -1;
+  int wallRegionY = -1;
+  if (!world.skipsEmptyRegions()) {
+    wallRegionShift = kNoLeapShift;
+    wallRegionX = wallRegionY = 0;
+  }
+
+  hit.sideHit = false;
+  do {
+    if ((hit.map.x() >> wallRegionShift) != wallRegionX ||
+        (hit.map.y() >> wallRegionShift) != wallRegionY) {
+      const WorldMap::Region region = world.region(hit.map.x(), hit.map.y());
+      if (!region.empty) {
+        wallRegionShift = region.shift;
+        wallRegionX = hit.map.x() >> region.shift;
+        wallRegionY = hit.map.y() >> region.shift;
+      } else if (leapEmptyRegion(region.shift, rayDir, deltaDist, stepX, stepY, hit.map, sideDist,
+                                 hit.sideHit)) {
+        continue;
+      }
+    }
+
+    if (sideDist.x() <= sideDist.y()) {
+      sideDist.x() += deltaDist.x();
+      hit.map.x() += stepX;
+      hit.sideHit = false;
+    } else {
+      sideDist.y() += deltaDist.y();
+      hit.map.y() += stepY;
+      hit.sideHit = true;
+    }
+  } while (!world.isWall(hit.map));
+
+  if (hit.sideHit) {
+    hit.perpWallDist = (hit.map.y() - pos.y() + (1 - stepY) / 2) / rayDir.y();
+  } else {
+    hit.perpWallDist = (hit.map.x() - pos.x() + (1 - stepX) / 2) / rayDir.x();
+  }
+
+  hit.lineHeight = static_cast<int>(screenHeight / hit.perpWallDist);
+
+  // where was the wall hit exactly
+  double wallX = hit.sideHit ? pos.x() + hit.perpWallDist * rayDir.x()
+                             : pos.y() + hit.perpWallDist * rayDir.y();
+  wallX -= std::floor(wallX);
+
+  hit.u = static_cast<int>(wallX * static_cast<double>(texWidth));
+  if ((!hit.sideHit && rayDir.x() > 0) || (hit.sideHit && rayDir.y() < 0)) {
+    hit.u = texWidth - hit.u - 1;
+  }
+
+  return hit;
+}
+
+WallHit castRayFixed(const WorldMap& world, const Vector2d& pos, const RaySetup& ray,
+                     int screenHeight, int texWidth) {
+  WallHit hit;
+
+  const std::int32_t posX = toFixed(pos.x());
+  const std::int32_t posY = toFixed(pos.y());
+  const std::int32_t deltaDistX = ray.fixedDeltaDistX;
+  const std::int32_t deltaDistY = ray.fixedDeltaDistY;
+  const int stepX = ray.stepX;
+  const int stepY = ray.stepY;
+
+  int mapX = posX >> kFixedShift;
+  int mapY = posY >> kFixedShift;
+
+  std::int32_t sideDistX, sideDistY;
+  if (stepX < 0) {
+    sideDistX = fixedMul(posX & kFixedFractionMask, deltaDistX);
+  } else {
+    sideDistX = fixedMul(kFixedOne - (posX & kFixedFractionMask), deltaDistX);
+  }
+  if (stepY < 0) {
+    sideDistY = fixedMul(posY & kFixedFractionMask, deltaDistY);
+  } else {
+    sideDistY = fixedMul(kFixedOne - (posY & kFixedFractionMask), deltaDistY);
+  }
+
+  int wallRegionShift = 0;
+  int wallRegionX = -1;
+  int wallRegionY = -1;
+  if (!world.skipsEmptyRegions()) {
+    wallRegionShift = kNoLeapShift;
+    wallRegionX = wallRegionY = 0;
+  }
+
+  bool sideHit = false;
+  do {
+    if ((mapX >> wallRegionShift) != wallRegionX || (mapY >> wallRegionShift) != wallRegionY) {
+      const WorldMap::Region region = world.region(mapX, mapY);
+      if (region.empty) {
+        leapEmptyRegionFixed(region.shift, deltaDistX, deltaDistY, stepX, stepY, mapX, mapY,
+                             sideDistX, sideDistY, sideHit);
+        continue;
+      }
+      wallRegionShift = region.shift;
+      wallRegionX = mapX >> region.shift;
+      wallRegionY = mapY >> region.shift;
+    }
+
+    if (sideDistX <= sideDistY) {
+      sideDistX += deltaDistX;
+      mapX += stepX;
+      sideHit = false;
+    } else {
+      sideDistY += deltaDistY;
+      mapY += stepY;
+      sideHit = true;
+    }
+  } while (!world.isWall(mapX, mapY));
+
+  // the side distance overshoots the wall by exactly one delta distance
+  const std::int32_t perpWallDist =
+      std::max(1, sideHit ? sideDistY - deltaDistY : sideDistX - deltaDistX);
+
+  hit.map = Vector2i{mapX, mapY};
+  hit.sideHit = sideHit;
+  hit.perpWallDist = static_cast<double>(perpWallDist) / kFixedOne;
+  hit.lineHeight = static_cast<int>((static_cast<std::int64_t>(screenHeight) << kFixedShift) /
+                                    perpWallDist);
+
+  const std::int32_t wallX = sideHit ? posX + fixedMul(perpWallDist, ray.fixedDirX)
+                                      : posY + fixedMul(perpWallDist, ray.fixedDirY);
+  hit.u = ((wallX & kFixedFractionMask) * texWidth) >> kFixedShift;
+  if ((!sideHit && ray.dir.x() > 0) || (sideHit && ray.dir.y() < 0)) {
+    hit.u = texWidth - hit.u - 1;
+  }
+
+  return hit;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+
+class WorldMap;
+
+// Size of every wall, floor and sprite texture
+static constexpr int kTexWidth = 64;
+static constexpr int kTexHeight = 64;
+
+enum class RayCastPrecision {
+  Double,
+  // 16.16 fixed point DDA, rays can travel at most 32767 cells
+  FixedPoint,
+};
+
+// Where a ray hit a wall and how that wall slice maps to the screen
+struct WallHit {
+  // map cell that was hit
+  Eigen::Vector2i map;
+  // whether the ray hit a side facing the y axis
+  bool sideHit;
+  // distance projected on camera direction (Euclidean distance will give fisheye effect!)
+  double perpWallDist;
+  // height of the wall slice on screen
+  int lineHeight;
+  // x coordinate of the texture
+  int u;
+};
+
+// Everything about a ray that only depends on its direction
+struct RaySetup {
+  Eigen::Vector2d dir;
+  // length of ray from one x or y side to next x or y side
+  Eigen::Vector2d deltaDist;
+  // what direction to step in x or y direction (either +1 or -1)
+  int stepX;
+  int stepY;
+  // 16.16 fixed point versions for `castRayFixed`
+  std::int32_t fixedDirX;
+  std::int32_t fixedDirY;
+  std::int32_t fixedDeltaDistX;
+  std::int32_t fixedDeltaDistY;
+};
+
+RaySetup setupRay(const Eigen::Vector2d& rayDir);
+
+// Casts a ray from `pos` until it hits a wall, using double precision throughout
+WallHit castRay(const WorldMap& world, const Eigen::Vector2d& pos, const RaySetup& ray,
+                int screenHeight, int texWidth);
+
+// Same as `castRay`, but the DDA walk and hit evaluation run on 16.16 fixed point integers. The
+// results agree with `castRay` up to rounding.
+WallHit castRayFixed(const WorldMap& world, const Eigen::Vector2d& pos, const RaySetup& ray,
+                     int screenHeight, int texWidth);
@@ -0,0 +1,262 @@
+// Checks that the fixed point DDA agrees with the double precision one on random rays through the
+// built-in map, and that leaping over the empty regions of a large generated map finds the same
+// walls as stepping through every cell. Exits with a non-zero status on the first disagreement
+// beyond the bounds below.
+
+#include "raycast.hpp"
+#include "worldmap.hpp"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Eigen;
+
+namespace {
+static constexpr int kRays = 100000;
+static constexpr unsigned int kSeed = 1;
+static constexpr int kScreenHeight = 480;
+static constexpr double kPi = 3.14159265358979323846;
+static constexpr double kFixedUnit = 1.0 / 65536;
+// rays grazing a corner may hit different cells, see below, but that has to stay rare
+static constexpr int kMaxCornerRays = kRays / 10000;
+
+// The generated map: 4x4 chunks that are empty but for a few pillars, some of them too many to
+// leap over. Rays start in the chunks the map loads right away around its center.
+static constexpr int kLeapMapSize = 4 * WorldMap::kChunkSize;
+static constexpr double kSparsePillars = 0.002;
+static constexpr double kDensePillars = 0.05;
+static constexpr double kLeapStartRadius = 1.5 * WorldMap::kChunkSize;
+
+// Bound on the difference of the perpendicular distances. The fixed point position is off by up to
+// one unit, which the delta distance of the axis that was hit scales up, and every step adds up to
+// one unit of rounding. The measured differences stay below about half of this.
+double distanceBound(const RaySetup& ray, const WallHit& hit, const Vector2d& pos) {
+  const double deltaDist = hit.sideHit ? ray.deltaDist.y() : ray.deltaDist.x();
+  const int steps = (hit.map - pos.cast<int>()).cwiseAbs().sum();
+  return kFixedUnit * (deltaDist + 1) * (steps + 2);
+}
+
+bool fail(const Vector2d& pos, const Vector2d& rayDir, const char* pWhat, double expected,
+          double actual, double bound) {
+  std::cout << "Ray from (" << pos.x() << ", " << pos.y() << ") along (" << rayDir.x() << ", "
+            << rayDir.y() << "): " << pWhat << " " << actual << " differs from " << expected
+            << " by more than " << bound << std::endl;
+  return false;
+}
+
+bool compareRay(const WorldMap& world, const Vector2d& pos, const Vector2d& rayDir,
+                int& cornerRays) {
+  const RaySetup ray = setupRay(rayDir);
+  const WallHit expected = castRay(world, pos, ray, kScreenHeight, kTexWidth);
+  const WallHit actual = castRayFixed(world, pos, ray, kScreenHeight, kTexWidth);
+  const double bound = distanceBound(ray, expected, pos);
+
+  if (actual.map != expected.map || actual.sideHit != expected.sideHit) {
+    // Where a ray passes through a cell corner within rounding, the two paths may take the corner
+    // on different sides. They then hit different faces or, where walls touch diagonally, one of
+    // them slips through and hits a wall further on. Either way the nearer hit has to be at the
+    // corner. Heights and texture columns of different faces are not comparable.
+    ++cornerRays;
+    const double nearer = std::min(expected.perpWallDist, actual.perpWallDist);
+    const Vector2d point = pos + rayDir * nearer;
+    const Vector2d corner{std::round(point.x()), std::round(point.y())};
+    const double cornerBound = bound * rayDir.norm();
+    if ((point - corner).norm() > cornerBound) {
+      return fail(pos, rayDir, "distance of a different hit from a corner", 0,
+                  (point - corner).norm(), cornerBound);
+    }
+    return true;
+  }
+
+  if (std::abs(actual.perpWallDist - expected.perpWallDist) > bound) {
+    return fail(pos, rayDir, "perpendicular distance", expected.perpWallDist, actual.perpWallDist,
+                bound);
+  }
+
+  // the height's derivative over the distance bound, plus one pixel for truncating either height
+  const double distance = expected.perpWallDist;
+  const double heightBound =
+      kScreenHeight * bound / (distance * std::max(distance - bound, kFixedUnit)) + 1;
+  if (std::abs(actual.lineHeight - expected.lineHeight) > heightBound) {
+    return fail(pos, rayDir, "line height", expected.lineHeight, actual.lineHeight, heightBound);
+  }
+
+  // the hit point moves along the wall by the distance difference times the ray component along
+  // it, plus a unit for the position, and either column may be truncated. Columns wrap around
+  // where the hit point is next to a cell edge.
+  const double along = std::abs(expected.sideHit ? rayDir.x() : rayDir.y());
+  const double texBound = kTexWidth * (bound * along + kFixedUnit) + 1;
+  const int columns = std::abs(actual.u - expected.u);
+  if (std::min(columns, kTexWidth - columns) > texBound) {
+    return fail(pos, rayDir, "texture column", expected.u, actual.u, texBound);
+  }
+  return true;
+}
+
+// The walk of `castRay` without leaps, one cell at a time. Only the cell and side are filled in.
+WallHit walkCells(const WorldMap& world, const Vector2d& pos, const RaySetup& ray) {
+  WallHit hit;
+  hit.map = pos.cast<int>();
+  Vector2d sideDist;
+  sideDist.x() = (ray.stepX < 0 ? pos.x() - hit.map.x() : hit.map.x() + 1.0 - pos.x()) *
+      ray.deltaDist.x();
+  sideDist.y() = (ray.stepY < 0 ? pos.y() - hit.map.y() : hit.map.y() + 1.0 - pos.y()) *
+      ray.deltaDist.y();
+  do {
+    if (sideDist.x() <= sideDist.y()) {
+      sideDist.x() += ray.deltaDist.x();
+      hit.map.x() += ray.stepX;
+      hit.sideHit = false;
+    } else {
+      sideDist.y() += ray.deltaDist.y();
+      hit.map.y() += ray.stepY;
+      hit.sideHit = true;
+    }
+  } while (!world.isWall(hit.map));
+  return hit;
+}
+
+// The same for `castRayFixed`
+WallHit walkCellsFixed(const WorldMap& world, const Vector2d& pos, const RaySetup& ray) {
+  const auto fraction = [](double value) {
+    const auto fixed = static_cast<std::int64_t>(std::floor(value / kFixedUnit));
+    return fixed & static_cast<std::int64_t>(1 / kFixedUnit - 1);
+  };
+  const auto sideDist = [](std::int64_t distance, std::int32_t deltaDist) {
+    return static_cast<std::int32_t>((distance * deltaDist) >> 16);
+  };
+  const std::int64_t one = static_cast<std::int64_t>(1 / kFixedUnit);
+
+  WallHit hit;
+  hit.map = pos.cast<int>();
+  std::int32_t sideDistX = sideDist(ray.stepX < 0 ? fraction(pos.x()) : one - fraction(pos.x()),
+                                    ray.fixedDeltaDistX);
+  std::int32_t sideDistY = sideDist(ray.stepY < 0 ? fraction(pos.y()) : one - fraction(pos.y()),
+                                    ray.fixedDeltaDistY);
+  do {
+    if (sideDistX <= sideDistY) {
+      sideDistX += ray.fixedDeltaDistX;
+      hit.map.x() += ray.stepX;
+      hit.sideHit = false;
+    } else {
+      sideDistY += ray.fixedDeltaDistY;
+      hit.map.y() += ray.stepY;
+      hit.sideHit = true;
+    }
+  } while (!world.isWall(hit.map));
+  return hit;
+}
+
+bool compareCells(const Vector2d& pos, const Vector2d& rayDir, const char* pWhat,
+                  const WallHit& expected, const WallHit& actual) {
+  if (actual.map == expected.map && actual.sideHit == expected.sideHit) {
+    return true;
+  }
+  std::cout << "Ray from (" << pos.x() << ", " << pos.y() << ") along (" << rayDir.x() << ", "
+            << rayDir.y() << "): " << pWhat << " hit (" << actual.map.x() << ", "
+            << actual.map.y() << ") side " << actual.sideHit << " instead of ("
+            << expected.map.x() << ", " << expected.map.y() << ") side " << expected.sideHit
+            << std::endl;
+  return false;
+}
+
+bool compareLeap(const WorldMap& world, const Vector2d& pos, const Vector2d& rayDir) {
+  const RaySetup ray = setupRay(rayDir);
+  return compareCells(pos, rayDir, "castRay", walkCells(world, pos, ray),
+                      castRay(world, pos, ray, kScreenHeight, kTexWidth)) &&
+      compareCells(pos, rayDir, "castRayFixed", walkCellsFixed(world, pos, ray),
+                   castRayFixed(world, pos, ray, kScreenHeight, kTexWidth));
+}
+
+bool writeLeapMap(const std::string& filename, std::mt19937& random) {
+  std::vector<std::uint16_t> cells(static_cast<std::size_t>(kLeapMapSize) * kLeapMapSize, 0);
+  std::uniform_real_distribution<double> chance{0, 1};
+  for (int y = 0; y < kLeapMapSize; ++y) {
+    for (int x = 0; x < kLeapMapSize; ++x) {
+      const bool edge = x == 0 || y == 0 || x == kLeapMapSize - 1 || y == kLeapMapSize - 1;
+      const bool dense = ((x >> WorldMap::kChunkShift) + (y >> WorldMap::kChunkShift)) % 3 == 0;
+      if (edge || chance(random) < (dense ? kDensePillars : kSparsePillars)) {
+        cells[static_cast<std::size_t>(y) * kLeapMapSize + x] = 1;
+      }
+    }
+  }
+  return writeMapFile(filename, kLeapMapSize, kLeapMapSize, cells);
+}
+
+Vector2d randomDir(std::mt19937& random) {
+  std::uniform_real_distribution<double> angle{0, 2 * kPi};
+  std::uniform_real_distribution<double> cameraX{-1, 1};
+  // the rays of a camera with a 90 degree field of view, like the renderer's
+  const Vector2d dir = Rotation2Dd{angle(random)}.toRotationMatrix() * Vector2d{0, 1};
+  const Vector2d plane{dir.y(), -dir.x()};
+  return dir + plane * cameraX(random);
+}
+
+bool testLeaps(std::mt19937& random) {
+  const char* pTempDir = std::getenv("TEST_TMPDIR");
+  const std::string filename = std::string{pTempDir ? pTempDir : "."} + "/raycast_test.map";
+  WorldMap world;
+  const bool loaded = writeLeapMap(filename, random) && world.load(filename);
+  std::remove(filename.c_str());
+  if (!loaded) {
+    return false;
+  }
+  const Vector2d center{world.width() / 2.0, world.height() / 2.0};
+  world.update(center);
+  if (!world.skipsEmptyRegions()) {
+    std::cout << "The generated map has no empty regions to leap over" << std::endl;
+    return false;
+  }
+
+  std::uniform_real_distribution<double> offset{-kLeapStartRadius, kLeapStartRadius};
+  for (int i = 0; i < kRays;) {
+    const Vector2d pos = center + Vector2d{offset(random), offset(random)};
+    if (!world.isEmpty(pos.cast<int>())) {
+      continue;
+    }
+    if (!compareLeap(world, pos, randomDir(random))) {
+      return false;
+    }
+    ++i;
+  }
+  std::cout << kRays << " rays leap to the same walls" << std::endl;
+  return true;
+}
+}  // namespace
+
+int main() {
+  WorldMap world;
+  world.update(Vector2d{world.width() / 2.0, world.height() / 2.0});
+
+  std::mt19937 random{kSeed};
+  std::uniform_real_distribution<double> x{0, static_cast<double>(world.width())};
+  std::uniform_real_distribution<double> y{0, static_cast<double>(world.height())};
+
+  int cornerRays = 0;
+  for (int i = 0; i < kRays;) {
+    const Vector2d pos{x(random), y(random)};
+    if (!world.isEmpty(pos.cast<int>())) {
+      continue;
+    }
+    if (!compareRay(world, pos, randomDir(random), cornerRays)) {
+      return EXIT_FAILURE;
+    }
+    ++i;
+  }
+
+  if (cornerRays > kMaxCornerRays) {
+    std::cout << cornerRays << " of " << kRays << " rays hit different cells, expected at most "
+              << kMaxCornerRays << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << kRays << " rays agree, " << cornerRays << " of them grazed a corner" << std::endl;
+
+  return testLeaps(random) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,49 @@
+#include "raytable.hpp"
+#include "floorspan.hpp"
+
+using namespace Eigen;
+
+bool RayTable::update(const Vector2d& dir, const Vector2d& plane, int screenWidth,
+                      int screenHeight) {
+  if (dir == m_dir && plane == m_plane && screenWidth == m_screenWidth &&
+      screenHeight == m_screenHeight) {
+    return false;
+  }
+  m_dir = dir;
+  m_plane = plane;
+  m_screenWidth = screenWidth;
+  m_screenHeight = screenHeight;
+
+  m_columns.resize(screenWidth);
+  for (int x = 0; x < screenWidth; ++x) {
+    double cameraX = 2 * x / static_cast<double>(screenWidth) - 1;  // x-coordinate in camera space
+    m_columns[x] = setupRay(dir + plane * cameraX);
+  }
+
+  const Vector2d rayDirLeft = dir - plane;
+  const Vector2d rayDirRight = dir + plane;
+
+  // vertical position of the camera
+  const double posZ = 0.5 * screenHeight;
+
+  m_floorRows.resize(screenHeight - screenHeight / 2);
+  for (int y = screenHeight / 2; y < screenHeight; ++y) {
+    // current y position compared to the center of the screen (horizon)
+    const int p = y - static_cast<int>(posZ);
+
+    // horizontal distance from the camera to the floor for the current row.
+    // 0.5 is the z position exactly in the middle between floor and ceiling.
+    const double rowDistance = posZ / p;
+
+    // calculate the real world step vector we have to add for each x (parallel to the camera
+    // plane). adding step by step avoids multiplications with a weight in the inner loop.
+    const Vector2d floorStep = rowDistance * (rayDirRight - rayDirLeft) / screenWidth;
+
+    FloorRow& row = m_floorRows[y - screenHeight / 2];
+    row.distance = rowDistance;
+    row.offset = rowDistance * rayDirLeft;
+    row.stepX = toFloorFraction(floorStep.x());
+    row.stepY = toFloorFraction(floorStep.y());
+  }
+  return true;
+}
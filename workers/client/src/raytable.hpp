@@ -0,0 +1,43 @@
+#pragma once
+
+#include "raycast.hpp"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
+
+// Ray setup for every screen column and floor row, which only depends on the camera orientation
+// and the screen size. While the player just moves around, every frame can reuse it as is.
+class RayTable {
+public:
+  struct FloorRow {
+    // distance from the camera to the floor in this row
+    double distance;
+    // offset from the player to the floor under the leftmost pixel of the row
+    Eigen::Vector2d offset;
+    // real world step between two pixels of the row, as wrapped 0.32 fixed point fractions
+    std::uint32_t stepX;
+    std::uint32_t stepY;
+  };
+
+  // Recomputes the table if the orientation or screen size changed, returns whether it did
+  bool update(const Eigen::Vector2d& dir, const Eigen::Vector2d& plane, int screenWidth,
+              int screenHeight);
+
+  const RaySetup& column(int x) const {
+    return m_columns[x];
+  }
+
+  // Only rows from the horizon (screenHeight / 2) downwards are stored
+  const FloorRow& floorRow(int y) const {
+    return m_floorRows[y - m_screenHeight / 2];
+  }
+
+private:
+  Eigen::Vector2d m_dir{0, 0};
+  Eigen::Vector2d m_plane{0, 0};
+  int m_screenWidth = 0;
+  int m_screenHeight = 0;
+
+  std::vector<RaySetup> m_columns;
+  std::vector<FloorRow> m_floorRows;
+};
@@ -1,45 +1,82 @@
 #include "renderer.hpp"
+#include "floorspan.hpp"
 #include "player.hpp"
+#include "profiler.hpp"
+#include "raycast.hpp"
+#include "shading.hpp"
+#include "transpose.hpp"
 #include "utils.hpp"
 #include "worldmap.hpp"
+#include <algorithm>
 #include <iostream>
 
 using namespace Eigen;
 
 namespace {
-inline void setSurfacePixel(SDL_Surface* pSurface, int x, int y, Uint32 color) {
-  Uint32* pTargetPixel = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pSurface->pixels) +
-                                                   y * pSurface->pitch + x * sizeof(*pTargetPixel));
-  *pTargetPixel = color;
+// Number of screen columns per wall rendering job. Wide enough to amortise scheduling, narrow
+// enough to balance the load between threads.
+constexpr int kWallTileWidth = 64;
+
+// Number of floor rows (each paired with its mirrored ceiling row) per floor rendering job
+constexpr int kFloorBandHeight = 16;
+
+// Number of rows per job when moving the column buffer into the back buffer
+constexpr int kResolveBandHeight = 16;
+
+// Number of distinct fog levels between the camera and the fog distance
+constexpr int kFogLutSize = 256;
+
+inline Uint32* surfaceRow(SDL_Surface* pSurface, int y) {
+  return reinterpret_cast<Uint32*>(static_cast<Uint8*>(pSurface->pixels) + y * pSurface->pitch);
+}
+
+// The bits of a 64 row coverage word starting at row `first` that lie in rows [begin, end)
+inline std::uint64_t rowBits(int first, int begin, int end) {
+  const int low = std::max(begin - first, 0);
+  const int high = std::min(end - first, 64);
+  const std::uint64_t below = high == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << high) - 1;
+  return below & (~std::uint64_t{0} << low);
 }
 
-inline Uint32 getSurfacePixel(SDL_Surface* pSurface, int x, int y) {
-  Uint32* pTargetPixel = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pSurface->pixels) +
-                                                   y * pSurface->pitch + x * sizeof(*pTargetPixel));
-  return *pTargetPixel;
+// a / b rounded up, for b > 0
+inline std::int64_t ceilDiv(std::int64_t a, std::int64_t b) {
+  return a >= 0 ? (a + b - 1) / b : -(-a / b);
 }
+
+inline bool sameColor(const SDL_Color& lhs, const SDL_Color& rhs) {
+  return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+}
+
 }  // namespace
 
 RayCasterRenderer::RayCasterRenderer(SDL_Window* pWindow, TTF_Font* pFont, int screenWidth,
-                                     int screenHeight, int texWidth, int texHeight)
+                                     int screenHeight, int texWidth, int texHeight,
+                                     std::size_t threadCount)
 : m_pWindow(pWindow)
 , m_pFont(pFont)
 , m_screenWidth(screenWidth)
 , m_screenHeight(screenHeight)
 , m_texWidth(texWidth)
-, m_texHeight(texHeight) {
-  m_pScreenSurface = SDL_GetWindowSurface(pWindow);
+, m_texHeight(texHeight)
+, m_atlas(texWidth, texHeight)
+, m_pThreadPool(new ThreadPool(threadCount)) {
+  m_pScreenSurface = pWindow ? SDL_GetWindowSurface(pWindow) : nullptr;
   m_pBackSurface = SDL_CreateRGBSurface(0, screenWidth, screenHeight, 32, 0x00ff0000, 0x0000ff00,
                                         0x000000ff, 0xff000000);
   m_zBuffer.resize(m_screenWidth);
+  m_columnBuffer.resize(static_cast<std::size_t>(m_screenWidth) * m_screenHeight);
+  m_coverageWordsPerColumn = (m_screenHeight + 63) / 64;
+  m_spriteCoverage.resize(static_cast<std::size_t>(m_screenWidth) * m_coverageWordsPerColumn);
 }
 
 RayCasterRenderer::~RayCasterRenderer() {
-  for (SDL_Surface* pTexture : m_darkTextures) {
-    SDL_FreeSurface(pTexture);
+  for (const Overlay& overlay : m_overlays) {
+    SDL_FreeSurface(overlay.pSurface);
   }
-  for (SDL_Surface* pTexture : m_textures) {
-    SDL_FreeSurface(pTexture);
+  for (const Overlay& overlay : m_presentedOverlays) {
+    if (overlay.pSurface) {
+      SDL_FreeSurface(overlay.pSurface);
+    }
   }
   if (m_pBackSurface) {
     SDL_FreeSurface(m_pBackSurface);
@@ -50,216 +87,322 @@ RayCasterRenderer::~RayCasterRenderer() {
 }
 
 const SDL_PixelFormat* RayCasterRenderer::getPixelFormat() const {
-  return m_pScreenSurface->format;
+  return m_pScreenSurface ? m_pScreenSurface->format : m_pBackSurface->format;
+}
+
+std::size_t RayCasterRenderer::threadCount() const {
+  return m_pThreadPool->threadCount();
 }
 
 void RayCasterRenderer::addTexture(SDL_Surface* pTexture) {
-  m_textures.push_back(pTexture);
-  m_darkTextures.push_back(createDarkTexture(pTexture));
+  m_atlas.add(pTexture);
+  SDL_FreeSurface(pTexture);
+  invalidate();
 }
 
 void RayCasterRenderer::setFloorTextureIndex(std::size_t index) {
   m_floorTextureIndex = index;
+  invalidate();
 }
 
 void RayCasterRenderer::setCeilingTextureIndex(std::size_t index) {
   m_ceilingTextureIndex = index;
+  invalidate();
 }
 
-void RayCasterRenderer::render(const WorldMap& world, const Player& player,
-                               const std::vector<Sprite>& sprites) const {
-  renderFloorAndCeilling(player);
-  renderWalls(world, player);
-  renderSprites(player, sprites);
+void RayCasterRenderer::setRayCastPrecision(RayCastPrecision precision) {
+  m_rayCastPrecision = precision;
+  invalidate();
 }
 
-void RayCasterRenderer::renderText(const char* pText, int x, int y, SDL_Color color) const {
-  SDL_Surface* pSurface = TTF_RenderText_Solid(m_pFont, pText, color);
-  if (!pSurface) {
-    std::cout << "Text render failed: " << TTF_GetError() << std::endl;
+void RayCasterRenderer::setTransposedRendering(bool enabled) {
+  m_transposedRendering = enabled;
+  invalidate();
+}
+
+void RayCasterRenderer::setFogDistance(double distance) {
+  invalidate();
+  m_fogLut.clear();
+  if (distance <= 0) {
     return;
   }
-  SDL_Rect rect{};
-  rect.x = x;
-  rect.y = y;
-  SDL_BlitSurface(pSurface, nullptr, m_pBackSurface, &rect);
-  SDL_FreeSurface(pSurface);
+
+  // linear falloff, but any curve is equally cheap at runtime
+  m_fogLut.resize(kFogLutSize);
+  for (int i = 0; i < kFogLutSize; ++i) {
+    m_fogLut[i] = kShadeFull - kShadeFull * i / (kFogLutSize - 1);
+  }
+  m_fogLutScale = (kFogLutSize - 1) / distance;
 }
 
-void RayCasterRenderer::present() const {
-  SDL_BlitSurface(m_pBackSurface, nullptr, m_pScreenSurface, nullptr);
-  SDL_UpdateWindowSurface(m_pWindow);
+void RayCasterRenderer::setProfiler(Profiler* pProfiler) {
+  m_pProfiler = pProfiler;
 }
 
-SDL_Surface* RayCasterRenderer::createDarkTexture(SDL_Surface* pSource) const {
-  SDL_Surface* pDark = SDL_DuplicateSurface(pSource);
-  for (int x = 0; x < pDark->w; ++x) {
-    for (int y = 0; y < pDark->h; ++y) {
-      Uint8 r, g, b;
-      Uint32 color = getSurfacePixel(pDark, x, y);
-      SDL_GetRGB(color, pDark->format, &r, &g, &b);
-      color = SDL_MapRGB(pDark->format, r >> 1, g >> 1, b >> 1);
-      setSurfacePixel(pDark, x, y, color);
-    }
+bool RayCasterRenderer::render(const WorldMap& world, const Player& player,
+                               const std::vector<Sprite>& sprites) const {
+  // the back buffer still holds this exact frame
+  if (!sceneChanged(world, player, sprites)) {
+    return false;
+  }
+
+  {
+    // only rotating the camera or resizing invalidates the ray setup
+    ScopedTimer timer{m_pProfiler, "rays"};
+    m_rayTable.update(player.dir(), player.camera().plane(), m_screenWidth, m_screenHeight);
+  }
+  {
+    ScopedTimer timer{m_pProfiler, "floor"};
+    renderFloorAndCeilling(player);
+  }
+  {
+    ScopedTimer timer{m_pProfiler, "walls"};
+    renderWalls(world, player);
+  }
+  {
+    ScopedTimer timer{m_pProfiler, "sprites"};
+    renderSprites(player, sprites);
   }
-  return pDark;
+  if (m_transposedRendering) {
+    ScopedTimer timer{m_pProfiler, "resolve"};
+    resolveColumnBuffer();
+  }
+  m_sceneDrawn = true;
+  return true;
 }
 
-void RayCasterRenderer::renderWalls(const WorldMap& world, const Player& player) const {
-  Vector2d pos = player.pos();
+void RayCasterRenderer::invalidate() const {
+  m_sceneValid = false;
+}
 
-  for (int x = 0; x < m_screenWidth; ++x) {
-    double cameraX =
-        2 * x / static_cast<double>(m_screenWidth) - 1;  // x-coordinate in camera space
-    Vector2d rayDir = player.dir() + player.camera().plane() * cameraX;
+bool RayCasterRenderer::sceneChanged(const WorldMap& world, const Player& player,
+                                     const std::vector<Sprite>& sprites) const {
+  const auto sameSprite = [](const Sprite& lhs, const Sprite& rhs) {
+    return lhs.pos == rhs.pos && lhs.texIndex == rhs.texIndex;
+  };
+  if (m_sceneValid && m_sceneKey.pWorld == &world && m_sceneKey.pos == player.pos() &&
+      m_sceneKey.dir == player.dir() && m_sceneKey.plane == player.camera().plane() &&
+      std::equal(sprites.begin(), sprites.end(), m_sceneKey.sprites.begin(),
+                 m_sceneKey.sprites.end(), sameSprite)) {
+    return false;
+  }
 
-    // which cell of the map we're in
-    Vector2i map = pos.cast<int>();
+  m_sceneKey.pWorld = &world;
+  m_sceneKey.pos = player.pos();
+  m_sceneKey.dir = player.dir();
+  m_sceneKey.plane = player.camera().plane();
+  m_sceneKey.sprites = sprites;
+  m_sceneValid = true;
+  return true;
+}
 
-    // length of ray from current position to next x or y side
-    Vector2d sideDist;
+void RayCasterRenderer::renderText(const char* pText, int x, int y, SDL_Color color) const {
+  // the same text at the same place as last frame keeps its surface and is not presented again
+  const std::size_t index = m_overlays.size();
+  if (index < m_presentedOverlays.size()) {
+    Overlay& previous = m_presentedOverlays[index];
+    if (previous.pSurface && previous.rect.x == x && previous.rect.y == y &&
+        sameColor(previous.color, color) && previous.text == pText) {
+      m_overlays.push_back(previous);
+      previous.pSurface = nullptr;
+      return;
+    }
+  }
 
-    // length of ray from one x or y side to next x or y side
-    // potential div/0 is safe as infinity will be correctly handled
-    Vector2d deltaDist{std::abs(1 / rayDir.x()), std::abs(1 / rayDir.y())};
-    double perpWallDist;
+  SDL_Surface* pSurface = TTF_RenderText_Solid(m_pFont, pText, color);
+  if (!pSurface) {
+    std::cout << "Text render failed: " << TTF_GetError() << std::endl;
+    return;
+  }
+  SDL_Rect rect{x, y, pSurface->w, pSurface->h};
+  m_overlays.push_back(Overlay{pText, color, rect, pSurface});
+  m_damage.push_back(rect);
+}
 
-    // what direction to step in x or y direction (either +1 or -1)
-    int stepX, stepY;
+void RayCasterRenderer::present() const {
+  ScopedTimer timer{m_pProfiler, "present"};
 
-    if (rayDir.x() < 0) {
-      stepX = -1;
-      sideDist.x() = (pos.x() - map.x()) * deltaDist.x();
-    } else {
-      stepX = 1;
-      sideDist.x() = (map.x() + 1.0 - pos.x()) * deltaDist.x();
+  // text that was shown last frame but not queued again has to be erased
+  for (const Overlay& overlay : m_presentedOverlays) {
+    if (overlay.pSurface) {
+      m_damage.push_back(overlay.rect);
+      SDL_FreeSurface(overlay.pSurface);
     }
-    if (rayDir.y() < 0) {
-      stepY = -1;
-      sideDist.y() = (pos.y() - map.y()) * deltaDist.y();
-    } else {
-      stepY = 1;
-      sideDist.y() = (map.y() + 1.0 - pos.y()) * deltaDist.y();
+  }
+  m_presentedOverlays.swap(m_overlays);
+  m_overlays.clear();
+
+  if (m_pWindow && m_sceneDrawn) {
+    SDL_BlitSurface(m_pBackSurface, nullptr, m_pScreenSurface, nullptr);
+    for (const Overlay& overlay : m_presentedOverlays) {
+      SDL_Rect rect = overlay.rect;
+      SDL_BlitSurface(overlay.pSurface, nullptr, m_pScreenSurface, &rect);
     }
-
-    bool hit = false;
-    bool sideHit = false;
-    while (!hit) {
-      if (sideDist.x() <= sideDist.y()) {
-        sideDist.x() += deltaDist.x();
-        map.x() += stepX;
-        sideHit = false;
-      } else {
-        sideDist.y() += deltaDist.y();
-        map.y() += stepY;
-        sideHit = true;
-      }
-
-      if (world.at(map)) {
-        hit = true;
+    SDL_UpdateWindowSurface(m_pWindow);
+  } else if (m_pWindow && !m_damage.empty()) {
+    // only the text changed, restore the scene below it and redraw the text on top
+    const SDL_Rect screenRect{0, 0, m_screenWidth, m_screenHeight};
+    std::size_t damageCount = 0;
+    for (std::size_t i = 0; i < m_damage.size(); ++i) {
+      const SDL_Rect rect = m_damage[i];
+      if (SDL_IntersectRect(&rect, &screenRect, &m_damage[damageCount])) {
+        presentRect(m_damage[damageCount++]);
       }
     }
+    if (damageCount > 0) {
+      SDL_UpdateWindowSurfaceRects(m_pWindow, m_damage.data(), static_cast<int>(damageCount));
+    }
+  }
+
+  m_sceneDrawn = false;
+  m_damage.clear();
+}
 
-    // calculate distance projected on camera direction (Euclidean distance will give fisheye
-    // effect!)
-    if (sideHit) {
-      perpWallDist = (map.y() - pos.y() + (1 - stepY) / 2) / rayDir.y();
-    } else {
-      perpWallDist = (map.x() - pos.x() + (1 - stepX) / 2) / rayDir.x();
+void RayCasterRenderer::presentRect(const SDL_Rect& rect) const {
+  SDL_Rect sceneRect = rect;
+  SDL_BlitSurface(m_pBackSurface, &rect, m_pScreenSurface, &sceneRect);
+  for (const Overlay& overlay : m_presentedOverlays) {
+    SDL_Rect overlap;
+    if (SDL_IntersectRect(&rect, &overlay.rect, &overlap)) {
+      const SDL_Rect source{overlap.x - overlay.rect.x, overlap.y - overlay.rect.y, overlap.w,
+                            overlap.h};
+      SDL_BlitSurface(overlay.pSurface, &source, m_pScreenSurface, &overlap);
     }
+  }
+}
+
+bool RayCasterRenderer::saveBackBuffer(const std::string& filename) const {
+  if (SDL_SaveBMP(m_pBackSurface, filename.c_str()) != 0) {
+    std::cout << "Could not save frame to '" << filename << "': " << SDL_GetError() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+unsigned int RayCasterRenderer::fogLevel(double distance) const {
+  if (m_fogLut.empty()) {
+    return kShadeFull;
+  }
+  const double index = distance * m_fogLutScale;
+  // also catches infinitely far rows at the horizon
+  if (!(index < kFogLutSize - 1)) {
+    return m_fogLut.back();
+  }
+  return m_fogLut[static_cast<int>(index)];
+}
+
+RayCasterRenderer::ColumnTarget RayCasterRenderer::columnTarget(int x) const {
+  if (m_transposedRendering) {
+    return ColumnTarget{m_columnBuffer.data() + x * m_screenHeight, 1};
+  }
+  return ColumnTarget{surfaceRow(m_pBackSurface, 0) + x,
+                      m_pBackSurface->pitch / static_cast<int>(sizeof(Uint32))};
+}
+
+void RayCasterRenderer::resolveColumnBuffer() const {
+  Uint32* pRows = surfaceRow(m_pBackSurface, 0);
+  const int rowPitch = m_pBackSurface->pitch / static_cast<int>(sizeof(Uint32));
+  m_pThreadPool->parallelFor(0, m_screenHeight, kResolveBandHeight, [&](int yBegin, int yEnd) {
+    resolveColumns(m_columnBuffer.data(), m_screenWidth, m_screenHeight, pRows, rowPitch, yBegin,
+                   yEnd);
+  });
+}
+
+void RayCasterRenderer::renderWalls(const WorldMap& world, const Player& player) const {
+  // every column is independent, so spread them over all threads
+  m_pThreadPool->parallelFor(0, m_screenWidth, kWallTileWidth, [&](int xBegin, int xEnd) {
+    renderWallColumns(world, player, xBegin, xEnd);
+  });
+}
 
-    // calculate height of line to draw on screen
-    int lineHeight = static_cast<int>(m_screenHeight / perpWallDist);
+void RayCasterRenderer::renderWallColumns(const WorldMap& world, const Player& player, int xBegin,
+                                          int xEnd) const {
+  const Vector2d& pos = player.pos();
+
+  for (int x = xBegin; x < xEnd; ++x) {
+    const RaySetup& ray = m_rayTable.column(x);
+    const WallHit wallHit = m_rayCastPrecision == RayCastPrecision::FixedPoint
+        ? castRayFixed(world, pos, ray, m_screenHeight, m_texWidth)
+        : castRay(world, pos, ray, m_screenHeight, m_texWidth);
+    const int lineHeight = wallHit.lineHeight;
+    const int u = wallHit.u;
+    const bool sideHit = wallHit.sideHit;
 
     // calculate lowest and highest pixel to fill in current stripe
     int drawStart = std::max(0, -lineHeight / 2 + m_screenHeight / 2);
     int drawEnd = std::min(m_screenHeight - 1, lineHeight / 2 + m_screenHeight / 2);
 
-    int texIndex = world.at(map) - 1;
+    int texIndex = world.atUnchecked(wallHit.map) - 1;
 
     // :TODO: remove when we have texture count validation
-    if (texIndex >= (int)m_textures.size()) {
+    if (texIndex >= (int)m_atlas.size()) {
       texIndex = 0;
     }
 
-    // where was the wall hit exactly
-    double wallX =
-        sideHit ? pos.x() + perpWallDist * rayDir.x() : pos.y() + perpWallDist * rayDir.y();
-    wallX -= std::floor(wallX);
-
-    // x coordinate of the texture
-    int u = static_cast<int>(wallX * static_cast<double>(m_texWidth));
-    if ((!sideHit && rayDir.x() > 0) || (sideHit && rayDir.y() < 0)) {
-      u = m_texWidth - u - 1;
-    }
-
     // how much to increase the texture coordinate per screen pixel
     double step = 1.0 * m_texHeight / lineHeight;
 
     // starting texture coordinate
     double texPos = (drawStart - m_screenHeight / 2 + lineHeight / 2) * step;
+
+    const Uint32* pTexels = m_atlas.column(texIndex, u);
+    const unsigned int shade =
+        combineShades(sideHit ? kShadeSide : kShadeFull, fogLevel(wallHit.perpWallDist));
+    const ColumnTarget target = columnTarget(x);
     for (int y = drawStart; y < drawEnd; ++y) {
       // cast the texture coordinate to integer and mask with (m_texHeight - 1) in case of overflow
       int v = static_cast<int>(texPos) & (m_texHeight - 1);
       texPos += step;
 
-      Uint32 color =
-          getSurfacePixel(sideHit ? m_darkTextures[texIndex] : m_textures[texIndex], u, v);
-
-      setSurfacePixel(m_pBackSurface, x, y, color | 0xff000000);
+      target.pFirst[y * target.stride] = shadeColor(pTexels[v], shade) | 0xff000000;
     }
 
-    m_zBuffer[x] = perpWallDist;
+    m_zBuffer[x] = wallHit.perpWallDist;
   }
 }
 
 void RayCasterRenderer::renderFloorAndCeilling(const Player& player) const {
-  for (int y = 0; y < m_screenHeight; ++y) {
-    Vector2d rayDirLeft = player.dir() - player.camera().plane();
-    Vector2d rayDirRight = player.dir() + player.camera().plane();
-
-    // vertical position of the camera
-    const double posZ = 0.5 * m_screenHeight;
-
-    // current y position compared to the center of the screen (horizon)
-    const int p = y - static_cast<int>(posZ);
-
-    // horizontal distance from the camera to the floor for the current row.
-    // 0.5 is the z position exactly in the middle between floor and ceiling.
-    const double rowDistance = posZ / p;
+  // Each floor row below the horizon also fills its mirrored ceiling row above it, so processing
+  // the lower half covers the whole screen and bands of rows never overlap between threads.
+  m_pThreadPool->parallelFor(m_screenHeight / 2, m_screenHeight, kFloorBandHeight,
+                             [&](int yBegin, int yEnd) {
+                               renderFloorAndCeillingRows(player, yBegin, yEnd);
+                             });
+}
 
-    // calculate the real world step vector we have to add for each x (parallel to the camera
-    // plane). adding step by step avoids multiplications with a weight in the inner loop.
-    const Vector2d floorStep = rowDistance * (rayDirRight - rayDirLeft) / m_screenWidth;
+void RayCasterRenderer::renderFloorAndCeillingRows(const Player& player, int yBegin,
+                                                   int yEnd) const {
+  for (int y = yBegin; y < yEnd; ++y) {
+    const RayTable::FloorRow& row = m_rayTable.floorRow(y);
 
     // real world coordinates of the leftmost column
-    Vector2d floor = player.pos() + rowDistance * rayDirLeft;
-
-    Vector2i texSize{m_texWidth, m_texHeight};
-
-    for (int x = 0; x < m_screenWidth; ++x) {
-      Vector2i cell = floor.cast<int>();
-
-      // texture coordinate
-      int u = static_cast<int>(m_texWidth * (floor.x() - cell.x())) & (m_texWidth - 1);
-      int v = static_cast<int>(m_texHeight * (floor.y() - cell.y())) & (m_texHeight - 1);
-
-      floor += floorStep;
-
-      // floor
-      Uint32 color = getSurfacePixel(m_darkTextures[m_floorTextureIndex], u, v);
-      setSurfacePixel(m_pBackSurface, x, y, color | 0xff000000);
-
-      // ceiling
-      color = getSurfacePixel(m_darkTextures[m_ceilingTextureIndex], u, v);
-      setSurfacePixel(m_pBackSurface, x, m_screenHeight - y - 1, color | 0xff000000);
-    }
+    const Vector2d floor = player.pos() + row.offset;
+
+    FloorSpan span;
+    span.startX = toFloorFraction(floor.x());
+    span.startY = toFloorFraction(floor.y());
+    span.stepX = row.stepX;
+    span.stepY = row.stepY;
+    span.texWidthLog2 = log2i(m_texWidth);
+    span.texHeightLog2 = log2i(m_texHeight);
+    span.count = m_screenWidth;
+    span.shadeLevel = combineShades(kShadeSide, fogLevel(row.distance));
+    span.floor = m_atlas.spanTexture(m_floorTextureIndex);
+    span.ceiling = m_atlas.spanTexture(m_ceilingTextureIndex);
+    span.pFloorOut = surfaceRow(m_pBackSurface, y);
+    span.pCeilingOut = surfaceRow(m_pBackSurface, m_screenHeight - y - 1);
+    drawFloorSpan(span);
   }
 }
 
 void RayCasterRenderer::renderSprites(const Player& player,
                                       const std::vector<Sprite>& sprites) const {
-  for (const Sprite& sprite : sprites) {
+  // Sprites come sorted from farthest to nearest but are drawn nearest first. Every pixel keeps the
+  // first opaque texel that lands on it, which is the one that drawing farthest first would have
+  // left there, and pixels already covered are skipped without fetching their texels.
+  std::fill(m_spriteCoverage.begin(), m_spriteCoverage.end(), 0);
+  for (auto it = sprites.rbegin(); it != sprites.rend(); ++it) {
+    const Sprite& sprite = *it;
     Vector2d toSprite = sprite.pos - player.pos();
     Vector2d transform = player.camera().inverseMatrix() * toSprite;
 
@@ -274,10 +417,26 @@ void RayCasterRenderer::renderSprites(const Player& player,
     // calculate lowest and highest pixel to fill in current stripe
     int drawStartY = std::max(0, -spriteHeight / 2 + m_screenHeight / 2);
     int drawEndY = std::min(m_screenHeight - 1, spriteHeight / 2 + m_screenHeight / 2);
+    if (drawStartY >= drawEndY) {
+      continue;
+    }
 
     int spriteWidth = spriteHeight;
     int drawStartX = std::max(0, -spriteWidth / 2 + spriteScreenX);
     int drawEndX = std::min(m_screenWidth - 1, spriteWidth / 2 + spriteScreenX);
+    const unsigned int shade = fogLevel(transform.y());
+
+    // The first row from which on the sprite shows texel `v` or a later one, found by solving
+    // v <= ((y * 256 - screenHeight * 128 + spriteHeight * 128) * texHeight / spriteHeight) / 256
+    // for y. With an odd screen height the top row can land on texel -1, i.e. in the column
+    // before, so texel 0 starts below it.
+    const auto firstRow = [&](int v) {
+      const std::int64_t d = v == 0
+          ? 1 - ceilDiv(std::int64_t{256} * spriteHeight, m_texHeight)
+          : ceilDiv(std::int64_t{256} * v * spriteHeight, m_texHeight);
+      return static_cast<int>(ceilDiv(
+          d + std::int64_t{128} * m_screenHeight - std::int64_t{128} * spriteHeight, 256));
+    };
 
     for (int stripe = drawStartX; stripe < drawEndX; ++stripe) {
       int u = static_cast<int>(256 * (stripe - (-spriteWidth / 2 + spriteScreenX)) * m_texWidth /
@@ -285,14 +444,38 @@ void RayCasterRenderer::renderSprites(const Player& player,
           256;
 
       if (stripe > 0 && stripe < m_screenWidth && transform.y() < m_zBuffer[stripe]) {
-        for (int y = drawStartY; y < drawEndY; ++y) {
-          int d = y * 256 - m_screenHeight * 128 +
-              spriteHeight * 128;  // 256 and 128 factors to avoid floats
-          int v = ((d * m_texHeight) / spriteHeight) / 256;
-
-          Uint32 color = getSurfacePixel(m_textures[sprite.texIndex], u, v);
-          if (color & 0x00ffffff) {
-            setSurfacePixel(m_pBackSurface, stripe, y, color | 0xff000000);
+        const TextureAtlas::ColumnRuns runs = m_atlas.opaqueRuns(sprite.texIndex, u);
+        if (runs.pBegin == runs.pEnd) {
+          continue;
+        }
+
+        const Uint32* pTexels = m_atlas.column(sprite.texIndex, u);
+        const ColumnTarget target = columnTarget(stripe);
+        std::uint64_t* pCoverage = &m_spriteCoverage[stripe * m_coverageWordsPerColumn];
+        for (const TextureAtlas::OpaqueRun* pRun = runs.pBegin; pRun != runs.pEnd; ++pRun) {
+          // every row in between shows an opaque texel and covers the pixel
+          const int runStartY = std::max(drawStartY, firstRow(pRun->start));
+          const int runEndY = std::min(drawEndY, firstRow(pRun->start + pRun->length));
+          if (runStartY >= runEndY) {
+            if (runStartY >= drawEndY) {
+              break;
+            }
+            continue;
+          }
+
+          for (int word = runStartY >> 6; word <= (runEndY - 1) >> 6; ++word) {
+            const std::uint64_t runRows = rowBits(word << 6, runStartY, runEndY);
+            std::uint64_t rows = ~pCoverage[word] & runRows;
+            while (rows) {
+              const int y = (word << 6) + countTrailingZeros(rows);
+              rows &= rows - 1;
+
+              int d = y * 256 - m_screenHeight * 128 +
+                  spriteHeight * 128;  // 256 and 128 factors to avoid floats
+              int v = ((d * m_texHeight) / spriteHeight) / 256;
+              target.pFirst[y * target.stride] = shadeColor(pTexels[v], shade) | 0xff000000;
+            }
+            pCoverage[word] |= runRows;
           }
         }
       }
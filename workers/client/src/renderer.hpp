@@ -1,10 +1,18 @@
 #pragma once
 
+#include "raycast.hpp"
+#include "raytable.hpp"
 #include "sdl.hpp"
+#include "textureatlas.hpp"
+#include "threadpool.hpp"
 #include <Eigen/Dense>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 class Player;
+class Profiler;
 class WorldMap;
 
 struct Sprite {
@@ -15,31 +23,85 @@ struct Sprite {
 
 class RayCasterRenderer {
 public:
+  // A thread count of 0 renders with one thread per hardware core. Without a window the renderer
+  // runs headless: it only draws into its back buffer and `present` does nothing.
   RayCasterRenderer(SDL_Window* pWindow, TTF_Font* pFont, int screenWidth, int screenHeight,
-                    int texWidth, int texHeight);
+                    int texWidth, int texHeight, std::size_t threadCount);
   ~RayCasterRenderer();
 
   const SDL_PixelFormat* getPixelFormat() const;
+  std::size_t threadCount() const;
 
   void addTexture(SDL_Surface* pTexture);
   void setFloorTextureIndex(std::size_t index);
   void setCeilingTextureIndex(std::size_t index);
+  void setRayCastPrecision(RayCastPrecision precision);
 
-  // Renders the scene to the back buffer
-  void render(const WorldMap& map, const Player& player, const std::vector<Sprite>& sprites) const;
+  // Draws walls and sprites into a column-major buffer that is transposed into the back buffer
+  // once per frame, so vertical strips are written sequentially. Enabled by default.
+  void setTransposedRendering(bool enabled);
 
-  // Renders text directly to the back buffer
+  // Fades everything to black towards the given distance, 0 disables the fog
+  void setFogDistance(double distance);
+
+  // Renders the scene to the back buffer. Returns false without drawing anything when the camera,
+  // the sprites and the renderer settings are the same as in the last rendered frame.
+  bool render(const WorldMap& map, const Player& player, const std::vector<Sprite>& sprites) const;
+
+  // Forces the next frame to be rendered and presented in full, e.g. after the map was edited or
+  // the window contents were lost
+  void invalidate() const;
+
+  // Queues text to be drawn over the scene by the next `present`
   void renderText(const char* pText, int x, int y, SDL_Color color) const;
 
-  // Copies the back buffer to the window
+  // Copies the scene and the queued text to the window. Only the regions that changed since the
+  // last call are updated, and nothing at all if the frame is identical.
   void present() const;
 
+  // Writes the back buffer (the scene without text) to a BMP file
+  bool saveBackBuffer(const std::string& filename) const;
+
+  // Reports the time spent in each rendering pass, may be null
+  void setProfiler(Profiler* pProfiler);
+
 private:
-  SDL_Surface* createDarkTexture(SDL_Surface* pSource) const;
+  // Text drawn over the scene, kept until the next frame so unchanged text is neither rendered
+  // again nor presented again
+  struct Overlay {
+    std::string text;
+    SDL_Color color;
+    SDL_Rect rect;
+    SDL_Surface* pSurface;
+  };
+
+  // Everything the rendered scene depends on besides the map contents and the textures
+  struct SceneKey {
+    const WorldMap* pWorld = nullptr;
+    Eigen::Vector2d pos;
+    Eigen::Vector2d dir;
+    Eigen::Vector2d plane;
+    std::vector<Sprite> sprites;
+  };
+
+  // Where to draw one vertical strip of the screen: pixel y lives at pFirst[y * stride]
+  struct ColumnTarget {
+    Uint32* pFirst;
+    int stride;
+  };
+
+  ColumnTarget columnTarget(int x) const;
+  unsigned int fogLevel(double distance) const;
 
-  void renderWalls(const WorldMap& world, const Player& player) const;
   void renderFloorAndCeilling(const Player& player) const;
+  void renderWalls(const WorldMap& world, const Player& player) const;
   void renderSprites(const Player& player, const std::vector<Sprite>& sprites) const;
+  void resolveColumnBuffer() const;
+  void renderWallColumns(const WorldMap& world, const Player& player, int xBegin, int xEnd) const;
+  void renderFloorAndCeillingRows(const Player& player, int yBegin, int yEnd) const;
+  bool sceneChanged(const WorldMap& world, const Player& player,
+                    const std::vector<Sprite>& sprites) const;
+  void presentRect(const SDL_Rect& rect) const;
 
   SDL_Window* m_pWindow;
   TTF_Font* m_pFont;
@@ -49,10 +111,30 @@ private:
   int m_screenHeight;
   int m_texWidth;
   int m_texHeight;
-  std::vector<SDL_Surface*> m_textures;
-  std::vector<SDL_Surface*> m_darkTextures;
+  TextureAtlas m_atlas;
   std::size_t m_floorTextureIndex = 0;
   std::size_t m_ceilingTextureIndex = 0;
+  RayCastPrecision m_rayCastPrecision = RayCastPrecision::Double;
+  bool m_transposedRendering = true;
+  // shade levels by distance, empty while fog is disabled
+  std::vector<unsigned int> m_fogLut;
+  double m_fogLutScale = 0;
+  std::unique_ptr<ThreadPool> m_pThreadPool;
+  Profiler* m_pProfiler = nullptr;
 
+  mutable RayTable m_rayTable;
   mutable std::vector<double> m_zBuffer;
+  // column-major walls and sprites, see `setTransposedRendering`
+  mutable std::vector<Uint32> m_columnBuffer;
+  // rows of each column that a sprite already covers, one bit per row, see `renderSprites`
+  int m_coverageWordsPerColumn = 0;
+  mutable std::vector<std::uint64_t> m_spriteCoverage;
+
+  // damage tracking, see `render` and `present`
+  mutable SceneKey m_sceneKey;
+  mutable bool m_sceneValid = false;
+  mutable bool m_sceneDrawn = false;
+  mutable std::vector<Overlay> m_overlays;
+  mutable std::vector<Overlay> m_presentedOverlays;
+  mutable std::vector<SDL_Rect> m_damage;
 };
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "sdl.hpp"
+
+// Shade levels scale every 8 bit channel of a pixel by level / 256
+static constexpr unsigned int kShadeFull = 256;
+// Walls facing the y axis are drawn at half brightness, which is also how floor and ceiling look
+static constexpr unsigned int kShadeSide = 128;
+
+// Scales the channels of a 32 bit pixel with 8 bit channels. Two channels are processed per
+// multiply, each in its own 16 bit lane, so nothing bleeds from one channel into the next.
+inline Uint32 shadeColor(Uint32 color, unsigned int level) {
+  const Uint32 redBlue = (((color & 0x00ff00ff) * level) >> 8) & 0x00ff00ff;
+  const Uint32 greenAlpha = (((color >> 8) & 0x00ff00ff) * level) & 0xff00ff00;
+  return redBlue | greenAlpha;
+}
+
+// Combines two shade levels
+inline unsigned int combineShades(unsigned int lhs, unsigned int rhs) {
+  return (lhs * rhs) >> 8;
+}
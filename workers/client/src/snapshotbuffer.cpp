@@ -0,0 +1,133 @@
+#include "snapshotbuffer.hpp"
+#include <algorithm>
+
+using namespace Eigen;
+
+std::size_t SnapshotBuffer::add(double time, const Vector2d& pos, const Vector2d& dir) {
+  const std::size_t slot = size();
+  const std::size_t entries = (slot + 1) * kCapacity;
+  m_times.resize(entries);
+  m_posX.resize(entries);
+  m_posY.resize(entries);
+  m_dirX.resize(entries);
+  m_dirY.resize(entries);
+  m_newest.push_back(0);
+  m_count.push_back(0);
+  m_pos.push_back(pos);
+  m_dir.push_back(dir);
+
+  push(slot, time, pos, dir);
+  return slot;
+}
+
+void SnapshotBuffer::remove(std::size_t slot) {
+  const std::size_t last = size() - 1;
+  if (slot != last) {
+    const auto moveLast = [&](std::vector<double>& values) {
+      std::copy_n(values.begin() + last * kCapacity, kCapacity, values.begin() + slot * kCapacity);
+    };
+    moveLast(m_times);
+    moveLast(m_posX);
+    moveLast(m_posY);
+    moveLast(m_dirX);
+    moveLast(m_dirY);
+    m_newest[slot] = m_newest[last];
+    m_count[slot] = m_count[last];
+    m_pos[slot] = m_pos[last];
+    m_dir[slot] = m_dir[last];
+  }
+
+  const std::size_t entries = last * kCapacity;
+  m_times.resize(entries);
+  m_posX.resize(entries);
+  m_posY.resize(entries);
+  m_dirX.resize(entries);
+  m_dirY.resize(entries);
+  m_newest.pop_back();
+  m_count.pop_back();
+  m_pos.pop_back();
+  m_dir.pop_back();
+}
+
+void SnapshotBuffer::push(std::size_t slot, double time, const Vector2d& pos,
+                          const Vector2d& dir) {
+  const std::size_t base = slot * kCapacity;
+  if (m_count[slot] > 0 && time <= m_times[base + m_newest[slot]]) {
+    return;
+  }
+
+  const int newest = m_count[slot] > 0 ? (m_newest[slot] + 1) & kMask : 0;
+  m_times[base + newest] = time;
+  m_posX[base + newest] = pos.x();
+  m_posY[base + newest] = pos.y();
+  m_dirX[base + newest] = dir.x();
+  m_dirY[base + newest] = dir.y();
+  m_newest[slot] = static_cast<std::uint8_t>(newest);
+  m_count[slot] = static_cast<std::uint8_t>(std::min(m_count[slot] + 1, kCapacity));
+}
+
+void SnapshotBuffer::evaluate(double time, Interpolation interpolation, double maxExtrapolation) {
+  for (std::size_t slot = 0; slot < size(); ++slot) {
+    const std::size_t base = slot * kCapacity;
+    const int count = m_count[slot];
+    const int newest = m_newest[slot];
+    const double* pTimes = &m_times[base];
+    const double* pPosX = &m_posX[base];
+    const double* pPosY = &m_posY[base];
+    const double* pDirX = &m_dirX[base];
+    const double* pDirY = &m_dirY[base];
+
+    // ring index of the newest snapshot at or before `time`, and how far back it is
+    int age = 0;
+    while (age < count - 1 && pTimes[(newest - age) & kMask] > time) {
+      ++age;
+    }
+    const int from = (newest - age) & kMask;
+
+    if (age == 0 || pTimes[from] > time) {
+      // past the newest snapshot or before the oldest, nothing to interpolate between
+      Vector2d pos{pPosX[from], pPosY[from]};
+      if (age == 0 && count > 1 && time > pTimes[from]) {
+        const int before = (from - 1) & kMask;
+        const double step = pTimes[from] - pTimes[before];
+        const double ahead = std::min(time - pTimes[from], maxExtrapolation);
+        pos += Vector2d{pPosX[from] - pPosX[before], pPosY[from] - pPosY[before]} * (ahead / step);
+      }
+      m_pos[slot] = pos;
+      m_dir[slot] = Vector2d{pDirX[from], pDirY[from]};
+      continue;
+    }
+
+    const int to = (from + 1) & kMask;
+    const double step = pTimes[to] - pTimes[from];
+    const double t = (time - pTimes[from]) / step;
+    const Vector2d p0{pPosX[from], pPosY[from]};
+    const Vector2d p1{pPosX[to], pPosY[to]};
+
+    if (interpolation == Interpolation::Hermite) {
+      // tangents from the snapshots on either side where there are any, scaled to the step
+      const bool hasBefore = age + 1 < count;
+      const bool hasAfter = age >= 2;
+      const int before = (from - 1) & kMask;
+      const int after = (to + 1) & kMask;
+      const Vector2d pBefore = hasBefore ? Vector2d{pPosX[before], pPosY[before]} : p0;
+      const Vector2d pAfter = hasAfter ? Vector2d{pPosX[after], pPosY[after]} : p1;
+      const double tBefore = hasBefore ? pTimes[before] : pTimes[from];
+      const double tAfter = hasAfter ? pTimes[after] : pTimes[to];
+      const Vector2d m0 = (p1 - pBefore) * (step / (pTimes[to] - tBefore));
+      const Vector2d m1 = (pAfter - p0) * (step / (tAfter - pTimes[from]));
+
+      const double t2 = t * t;
+      const double t3 = t2 * t;
+      m_pos[slot] = p0 * (2 * t3 - 3 * t2 + 1) + m0 * (t3 - 2 * t2 + t) + p1 * (3 * t2 - 2 * t3) +
+          m1 * (t3 - t2);
+    } else {
+      m_pos[slot] = p0 + (p1 - p0) * t;
+    }
+
+    const Vector2d dir = Vector2d{pDirX[from], pDirY[from]} * (1 - t) +
+        Vector2d{pDirX[to], pDirY[to]} * t;
+    const double length = dir.norm();
+    m_dir[slot] = length > 0 ? Vector2d{dir / length} : Vector2d{pDirX[to], pDirY[to]};
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class Interpolation {
+  Linear,
+  // cubic through the snapshots, with tangents from the neighbouring snapshots
+  Hermite,
+};
+
+// The most recent position and facing snapshots of every remote entity, so entities can be drawn
+// moving smoothly between the discrete updates the server sends. Each entity has a ring of
+// kCapacity snapshots. Entities occupy consecutive slots and every component is a separate array,
+// so evaluating all of them once per frame walks memory linearly.
+class SnapshotBuffer {
+public:
+  static constexpr int kCapacity = 8;
+
+  std::size_t size() const {
+    return m_newest.size();
+  }
+
+  // Appends an entity with its first snapshot and returns its slot
+  std::size_t add(double time, const Eigen::Vector2d& pos, const Eigen::Vector2d& dir);
+
+  // The last entity moves into the removed entity's slot
+  void remove(std::size_t slot);
+
+  // Snapshots that are not newer than the entity's newest one are dropped
+  void push(std::size_t slot, double time, const Eigen::Vector2d& pos, const Eigen::Vector2d& dir);
+
+  // Computes where every entity is at `time`: interpolated between the snapshots around it, or
+  // extrapolated along the last two snapshots for at most `maxExtrapolation` seconds past the
+  // newest one. Before the oldest snapshot and after extrapolating entities stand still.
+  void evaluate(double time, Interpolation interpolation, double maxExtrapolation);
+
+  // Results of the last `evaluate`
+  const Eigen::Vector2d& pos(std::size_t slot) const {
+    return m_pos[slot];
+  }
+  const Eigen::Vector2d& dir(std::size_t slot) const {
+    return m_dir[slot];
+  }
+
+private:
+  static constexpr int kMask = kCapacity - 1;
+  static_assert((kCapacity & kMask) == 0, "the snapshot ring size must be a power of two");
+
+  // kCapacity entries per slot
+  std::vector<double> m_times;
+  std::vector<double> m_posX;
+  std::vector<double> m_posY;
+  std::vector<double> m_dirX;
+  std::vector<double> m_dirY;
+  // per slot: ring index of the newest snapshot and the number of snapshots
+  std::vector<std::uint8_t> m_newest;
+  std::vector<std::uint8_t> m_count;
+
+  std::vector<Eigen::Vector2d> m_pos;
+  std::vector<Eigen::Vector2d> m_dir;
+};
@@ -0,0 +1,132 @@
+#include "spritegrid.hpp"
+#include "player.hpp"
+#include "visibilityset.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace Eigen;
+
+std::uint64_t SpriteGrid::bucketKey(const Vector2d& pos) {
+  const int x = static_cast<int>(std::floor(pos.x()));
+  const int y = static_cast<int>(std::floor(pos.y()));
+  return bucketKey(x >> kBucketShift, y >> kBucketShift);
+}
+
+SpriteGrid::SpriteId SpriteGrid::insert(const Sprite& sprite) {
+  SpriteId id;
+  if (m_freeIds.empty()) {
+    id = static_cast<SpriteId>(m_entries.size());
+    m_entries.emplace_back();
+  } else {
+    id = m_freeIds.back();
+    m_freeIds.pop_back();
+  }
+  m_entries[id].sprite = sprite;
+  addToBucket(id, bucketKey(sprite.pos));
+  return id;
+}
+
+void SpriteGrid::remove(SpriteId id) {
+  removeFromBucket(id);
+  m_freeIds.push_back(id);
+}
+
+void SpriteGrid::move(SpriteId id, const Vector2d& pos) {
+  Entry& entry = m_entries[id];
+  entry.sprite.pos = pos;
+  const std::uint64_t bucket = bucketKey(pos);
+  if (bucket != entry.bucket) {
+    removeFromBucket(id);
+    addToBucket(id, bucket);
+  }
+}
+
+void SpriteGrid::setVisibilitySet(const VisibilitySet* pVisibilitySet) {
+  m_pVisibilitySet = pVisibilitySet;
+}
+
+void SpriteGrid::addToBucket(SpriteId id, std::uint64_t bucket) {
+  std::vector<SpriteId>& ids = m_buckets[bucket];
+  m_entries[id].bucket = bucket;
+  m_entries[id].slot = static_cast<std::uint32_t>(ids.size());
+  ids.push_back(id);
+}
+
+void SpriteGrid::removeFromBucket(SpriteId id) {
+  const Entry& entry = m_entries[id];
+  std::vector<SpriteId>& ids = m_buckets.find(entry.bucket)->second;
+
+  // the last sprite of the bucket takes the place of the removed one. Empty buckets are kept, so
+  // sprites moving back and forth between blocks do not allocate.
+  const SpriteId last = ids.back();
+  ids[entry.slot] = last;
+  m_entries[last].slot = entry.slot;
+  ids.pop_back();
+}
+
+void SpriteGrid::query(const Player& player, double maxDistance, double spriteRadius,
+                       std::vector<SpriteId>& ids) const {
+  const Vector2d& pos = player.pos();
+  const Vector2d& dir = player.dir();
+  const Vector2d& plane = player.camera().plane();
+  const Vector2i playerCell = pos.cast<int>();
+  const bool culls = m_pVisibilitySet && m_pVisibilitySet->culls(spriteRadius);
+  if (culls) {
+    // sprites past the end of every sightline from the player's cell cannot reach into view
+    maxDistance =
+        std::min(maxDistance, m_pVisibilitySet->sightDistance(playerCell) + spriteRadius);
+  }
+
+  // the view frustum out to `maxDistance` lies in the triangle between the camera and the far ends
+  // of its edges
+  const double bucketSize = 1 << kBucketShift;
+  const double bucketRadius = bucketSize * std::sqrt(0.5) + spriteRadius;
+  const double farScale = maxDistance / dir.norm();
+  const Vector2d left = pos + (dir - plane) * farScale;
+  const Vector2d right = pos + (dir + plane) * farScale;
+  const Vector2d lower = pos.cwiseMin(left).cwiseMin(right).array() - spriteRadius;
+  const Vector2d upper = pos.cwiseMax(left).cwiseMax(right).array() + spriteRadius;
+  const int minX = static_cast<int>(std::floor(lower.x())) >> kBucketShift;
+  const int minY = static_cast<int>(std::floor(lower.y())) >> kBucketShift;
+  const int maxX = static_cast<int>(std::floor(upper.x())) >> kBucketShift;
+  const int maxY = static_cast<int>(std::floor(upper.y())) >> kBucketShift;
+
+  // outward normals of the frustum's side edges
+  const Vector2d leftEdge = dir - plane;
+  const Vector2d rightEdge = dir + plane;
+  Vector2d leftNormal = Vector2d{leftEdge.y(), -leftEdge.x()}.normalized();
+  Vector2d rightNormal = Vector2d{rightEdge.y(), -rightEdge.x()}.normalized();
+  if (leftNormal.dot(plane) > 0) {
+    leftNormal = -leftNormal;
+  }
+  if (rightNormal.dot(plane) < 0) {
+    rightNormal = -rightNormal;
+  }
+  const Vector2d forward = dir.normalized();
+
+  for (int bucketY = minY; bucketY <= maxY; ++bucketY) {
+    for (int bucketX = minX; bucketX <= maxX; ++bucketX) {
+      const auto it = m_buckets.find(bucketKey(bucketX, bucketY));
+      if (it == m_buckets.end() || it->second.empty()) {
+        continue;
+      }
+
+      const Vector2d center = Vector2d{bucketX + 0.5, bucketY + 0.5} * bucketSize - pos;
+      if (center.dot(forward) < -bucketRadius || center.dot(leftNormal) > bucketRadius ||
+          center.dot(rightNormal) > bucketRadius) {
+        continue;
+      }
+      if (culls &&
+          !m_pVisibilitySet->isPotentiallyVisible(
+              playerCell, Vector2i{bucketX << kBucketShift, bucketY << kBucketShift})) {
+        continue;
+      }
+
+      for (SpriteId id : it->second) {
+        if ((m_entries[id].sprite.pos - pos).squaredNorm() <= maxDistance * maxDistance) {
+          ids.push_back(id);
+        }
+      }
+    }
+  }
+}
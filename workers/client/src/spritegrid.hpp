@@ -0,0 +1,66 @@
+#pragma once
+
+#include "renderer.hpp"
+#include "worldmap.hpp"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Player;
+class VisibilitySet;
+
+// Sprites bucketed by the 8x8 block of cells they stand in, so the sprites around the camera can be
+// found without looking at the rest of the world. Only blocks that held a sprite at some point have
+// a bucket, which keeps large and mostly empty maps cheap.
+class SpriteGrid {
+public:
+  using SpriteId = std::uint32_t;
+
+  // Ids of removed sprites are reused
+  SpriteId insert(const Sprite& sprite);
+  void remove(SpriteId id);
+  void move(SpriteId id, const Eigen::Vector2d& pos);
+
+  const Sprite& sprite(SpriteId id) const {
+    return m_entries[id].sprite;
+  }
+
+  std::size_t size() const {
+    return m_entries.size() - m_freeIds.size();
+  }
+
+  // Sprites that the set rules out from the player's cell are skipped by `query`, may be null
+  void setVisibilitySet(const VisibilitySet* pVisibilitySet);
+
+  // Appends the ids of the sprites within `maxDistance` of the player that may be in view.
+  // `spriteRadius` is how far to the side of its position a sprite is drawn, in cells.
+  void query(const Player& player, double maxDistance, double spriteRadius,
+             std::vector<SpriteId>& ids) const;
+
+private:
+  // the same blocks the visibility set is made of
+  static constexpr int kBucketShift = WorldMap::kBlockShift;
+
+  struct Entry {
+    Sprite sprite;
+    std::uint64_t bucket;
+    // index in the bucket's id list
+    std::uint32_t slot;
+  };
+
+  static std::uint64_t bucketKey(int bucketX, int bucketY) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(bucketY)) << 32) |
+        static_cast<std::uint32_t>(bucketX);
+  }
+
+  static std::uint64_t bucketKey(const Eigen::Vector2d& pos);
+
+  void addToBucket(SpriteId id, std::uint64_t bucket);
+  void removeFromBucket(SpriteId id);
+
+  std::vector<Entry> m_entries;
+  std::vector<SpriteId> m_freeIds;
+  std::unordered_map<std::uint64_t, std::vector<SpriteId>> m_buckets;
+  const VisibilitySet* m_pVisibilitySet = nullptr;
+};
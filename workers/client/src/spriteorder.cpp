@@ -0,0 +1,67 @@
+#include "spriteorder.hpp"
+#include <algorithm>
+#include <iterator>
+
+using namespace Eigen;
+
+void SpriteOrder::update(const SpriteGrid& grid, const std::vector<SpriteGrid::SpriteId>& visible,
+                         const Vector2d& playerPos) {
+  ++m_frame;
+  for (SpriteGrid::SpriteId id : visible) {
+    if (id >= m_visibleFrame.size()) {
+      m_visibleFrame.resize(id + 1, 0);
+      m_keptFrame.resize(id + 1, 0);
+    }
+    m_visibleFrame[id] = m_frame;
+  }
+
+  const auto distance = [&](SpriteGrid::SpriteId id) {
+    return (playerPos - grid.sprite(id).pos).squaredNorm();
+  };
+  const auto isFarther = [](const Entry& lhs, const Entry& rhs) {
+    return lhs.distance > rhs.distance;
+  };
+
+  // sprites still in view keep their place from the last frame, which is nearly right
+  std::size_t kept = 0;
+  for (const Entry& entry : m_order) {
+    if (m_visibleFrame[entry.id] == m_frame) {
+      m_keptFrame[entry.id] = m_frame;
+      m_order[kept++] = Entry{distance(entry.id), entry.id};
+    }
+  }
+  m_order.resize(kept);
+
+  // insertion sort moves each sprite only as far as it moved in the order, so repairing a nearly
+  // sorted order is close to linear
+  for (std::size_t i = 1; i < m_order.size(); ++i) {
+    const Entry entry = m_order[i];
+    std::size_t j = i;
+    for (; j > 0 && isFarther(entry, m_order[j - 1]); --j) {
+      m_order[j] = m_order[j - 1];
+    }
+    m_order[j] = entry;
+  }
+
+  // sprites that just came into view could belong anywhere, so they are sorted on their own and
+  // merged in
+  m_added.clear();
+  for (SpriteGrid::SpriteId id : visible) {
+    if (m_keptFrame[id] != m_frame) {
+      m_added.push_back(Entry{distance(id), id});
+    }
+  }
+  if (!m_added.empty()) {
+    std::sort(m_added.begin(), m_added.end(), isFarther);
+    m_merged.clear();
+    std::merge(m_order.begin(), m_order.end(), m_added.begin(), m_added.end(),
+               std::back_inserter(m_merged), isFarther);
+    m_order.swap(m_merged);
+  }
+
+  m_sprites.clear();
+  for (const Entry& entry : m_order) {
+    m_sprites.push_back(grid.sprite(entry.id));
+    m_sprites.back().distance = entry.distance;
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "renderer.hpp"
+#include "spritegrid.hpp"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
+
+// Orders the visible sprites from farthest to nearest for the renderer. Between two frames the
+// camera moves only a little, so the previous order is kept and repaired instead of sorting all
+// visible sprites from scratch.
+class SpriteOrder {
+public:
+  // Orders the sprites of `grid` listed in `visible` for a camera at `playerPos`. Every id may
+  // appear only once.
+  void update(const SpriteGrid& grid, const std::vector<SpriteGrid::SpriteId>& visible,
+              const Eigen::Vector2d& playerPos);
+
+  // Sprites from farthest to nearest, with their squared distance filled in
+  const std::vector<Sprite>& sprites() const {
+    return m_sprites;
+  }
+
+private:
+  struct Entry {
+    double distance;
+    SpriteGrid::SpriteId id;
+  };
+
+  std::vector<Entry> m_order;
+  // sprites that came into view this frame, and the buffer they are merged into m_order with
+  std::vector<Entry> m_added;
+  std::vector<Entry> m_merged;
+  // per sprite id, the last update it was visible in and the last one it was kept from the
+  // previous order in
+  std::vector<std::uint32_t> m_visibleFrame;
+  std::vector<std::uint32_t> m_keptFrame;
+  std::uint32_t m_frame = 0;
+  std::vector<Sprite> m_sprites;
+};
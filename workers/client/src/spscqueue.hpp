@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded ring buffer between exactly one producer thread and one consumer thread. Neither side
+// ever locks or waits: pushing to a full queue and popping from an empty one fail instead. Slots
+// are allocated once, the capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+public:
+  explicit SpscQueue(std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    m_slots.resize(size);
+    m_mask = size - 1;
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Producer only
+  bool tryPush(const T& value) {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_cachedHead > m_mask) {
+      m_cachedHead = m_head.load(std::memory_order_acquire);
+      if (tail - m_cachedHead > m_mask) {
+        return false;
+      }
+    }
+    m_slots[tail & m_mask] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only
+  bool tryPop(T& value) {
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_cachedTail) {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head == m_cachedTail) {
+        return false;
+      }
+    }
+    value = m_slots[head & m_mask];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  std::vector<T> m_slots;
+  std::size_t m_mask;
+
+  // Each side owns a cache line with its index and its last look at the other side's index, so
+  // the other index is only read again when the queue seems full or empty. The sides are padded
+  // apart rather than aligned: an over-aligned queue could not be allocated with `new` before
+  // C++17, and neither could anything holding one.
+  char m_padBeforeTail[kCacheLineSize];
+  std::atomic<std::size_t> m_tail{0};
+  std::size_t m_cachedHead = 0;
+  char m_padBeforeHead[kCacheLineSize];
+  std::atomic<std::size_t> m_head{0};
+  std::size_t m_cachedTail = 0;
+  char m_padAfterHead[kCacheLineSize];
+};
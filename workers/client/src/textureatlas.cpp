@@ -0,0 +1,43 @@
+#include "textureatlas.hpp"
+#include "utils.hpp"
+
+TextureAtlas::TextureAtlas(int texWidth, int texHeight)
+: m_texWidth(texWidth)
+, m_texHeight(texHeight)
+, m_widthShift(log2i(texWidth))
+, m_heightShift(log2i(texHeight))
+, m_slotShift(log2i(texWidth) + log2i(texHeight))
+, m_runOffsets(1, 0) {}
+
+std::size_t TextureAtlas::add(SDL_Surface* pTexture) {
+  const std::size_t index = m_size++;
+  m_texels.resize(m_size << m_slotShift);
+
+  for (int u = 0; u < m_texWidth; ++u) {
+    Uint32* pColumn = m_texels.data() + (index << m_slotShift) +
+        (static_cast<std::size_t>(u) << m_heightShift);
+    for (int v = 0; v < m_texHeight; ++v) {
+      pColumn[v] = *reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(pTexture->pixels) +
+                                                    v * pTexture->pitch + u * sizeof(Uint32));
+    }
+
+    for (int v = 0; v < m_texHeight;) {
+      if (!(pColumn[v] & 0x00ffffff)) {
+        ++v;
+        continue;
+      }
+      const int start = v;
+      while (v < m_texHeight && (pColumn[v] & 0x00ffffff)) {
+        ++v;
+      }
+      m_runs.push_back(OpaqueRun{static_cast<std::uint16_t>(start),
+                                 static_cast<std::uint16_t>(v - start)});
+    }
+    m_runOffsets.push_back(static_cast<std::uint32_t>(m_runs.size()));
+  }
+  return index;
+}
+
+SpanTexture TextureAtlas::spanTexture(std::size_t index) const {
+  return SpanTexture{m_texels.data() + (index << m_slotShift), m_heightShift, 0};
+}
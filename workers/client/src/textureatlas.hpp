@@ -0,0 +1,62 @@
+#pragma once
+
+#include "floorspan.hpp"
+#include "sdl.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// All textures of the renderer in one contiguous block of memory. Every texture occupies a slot
+// of texWidth * texHeight texels (both powers of two) and is stored column by column, so texel
+// (u, v) of texture i lives at (i << slotShift) + (u << heightShift) + v.
+class TextureAtlas {
+public:
+  // Texels [start, start + length) of a texture column, none of them transparent
+  struct OpaqueRun {
+    std::uint16_t start;
+    std::uint16_t length;
+  };
+
+  // The opaque runs of one texture column from top to bottom
+  struct ColumnRuns {
+    const OpaqueRun* pBegin;
+    const OpaqueRun* pEnd;
+  };
+
+  TextureAtlas(int texWidth, int texHeight);
+
+  // Copies a texture into the next slot and returns its index
+  std::size_t add(SDL_Surface* pTexture);
+
+  std::size_t size() const {
+    return m_size;
+  }
+
+  // Texel v of column u of a texture lives at [v]
+  const Uint32* column(std::size_t index, int u) const {
+    return m_texels.data() + (index << m_slotShift) + (static_cast<std::size_t>(u) << m_heightShift);
+  }
+
+  // Sprites skip transparent texels, which are black in the color channels. Their opaque runs are
+  // found once when a texture is added.
+  ColumnRuns opaqueRuns(std::size_t index, int u) const {
+    const std::size_t column = (index << m_widthShift) + u;
+    return ColumnRuns{m_runs.data() + m_runOffsets[column],
+                      m_runs.data() + m_runOffsets[column + 1]};
+  }
+
+  SpanTexture spanTexture(std::size_t index) const;
+
+private:
+  int m_texWidth;
+  int m_texHeight;
+  int m_widthShift;
+  int m_heightShift;
+  int m_slotShift;
+  std::size_t m_size = 0;
+  std::vector<Uint32> m_texels;
+  // the runs of column u of texture i are m_runs[m_runOffsets[c]] up to m_runOffsets[c + 1],
+  // where c = (i << widthShift) + u
+  std::vector<OpaqueRun> m_runs;
+  std::vector<std::uint32_t> m_runOffsets;
+};
@@ -0,0 +1,92 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  m_workers.reserve(threadCount - 1);
+  for (std::size_t i = 1; i < threadCount; ++i) {
+    m_workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_quit = true;
+  }
+  m_jobCondition.notify_all();
+  for (std::thread& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int tileSize,
+                             const std::function<void(int, int)>& fn) {
+  if (begin >= end) {
+    return;
+  }
+  tileSize = std::max(1, tileSize);
+
+  // not worth waking anybody up for a single tile
+  if (m_workers.empty() || end - begin <= tileSize) {
+    fn(begin, end);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_pJob = &fn;
+    m_jobEnd = end;
+    m_jobTileSize = tileSize;
+    m_nextTile = begin;
+    m_busyWorkers = m_workers.size();
+    ++m_jobGeneration;
+  }
+  m_jobCondition.notify_all();
+
+  runTiles();
+
+  std::unique_lock<std::mutex> lock{m_mutex};
+  m_doneCondition.wait(lock, [this] { return m_busyWorkers == 0; });
+  m_pJob = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+  std::uint64_t seenGeneration = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock{m_mutex};
+      m_jobCondition.wait(lock, [&] { return m_quit || m_jobGeneration != seenGeneration; });
+      if (m_quit) {
+        return;
+      }
+      seenGeneration = m_jobGeneration;
+    }
+
+    runTiles();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (--m_busyWorkers == 0) {
+      m_doneCondition.notify_one();
+    }
+  }
+}
+
+void ThreadPool::runTiles() {
+  for (;;) {
+    int tileBegin, tileEnd;
+    {
+      // tiles are coarse enough that a lock per tile doesn't show up in profiles
+      std::lock_guard<std::mutex> lock{m_mutex};
+      if (m_nextTile >= m_jobEnd) {
+        return;
+      }
+      tileBegin = m_nextTile;
+      tileEnd = std::min(m_jobEnd, tileBegin + m_jobTileSize);
+      m_nextTile = tileEnd;
+    }
+    (*m_pJob)(tileBegin, tileEnd);
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of persistent worker threads that split index ranges into tiles and process them in
+// parallel. The calling thread always takes part, so a pool with a thread count of 1 spawns no
+// workers at all and simply runs everything inline.
+class ThreadPool {
+public:
+  // A thread count of 0 uses one thread per hardware core.
+  explicit ThreadPool(std::size_t threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Total number of threads working on a job, including the calling thread
+  std::size_t threadCount() const {
+    return m_workers.size() + 1;
+  }
+
+  // Calls `fn(tileBegin, tileEnd)` for consecutive tiles of at most `tileSize` indices covering
+  // [begin, end) and blocks until all tiles are done. Tiles may run concurrently, so `fn` must only
+  // touch state that is disjoint between tiles.
+  void parallelFor(int begin, int end, int tileSize, const std::function<void(int, int)>& fn);
+
+private:
+  void workerLoop();
+  void runTiles();
+
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_jobCondition;
+  std::condition_variable m_doneCondition;
+  std::uint64_t m_jobGeneration = 0;
+  std::size_t m_busyWorkers = 0;
+  bool m_quit = false;
+
+  // current job, only valid while a `parallelFor` call is running
+  const std::function<void(int, int)>* m_pJob = nullptr;
+  int m_jobEnd = 0;
+  int m_jobTileSize = 1;
+  int m_nextTile = 0;
+};
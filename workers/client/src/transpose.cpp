@@ -0,0 +1,103 @@
+#include "transpose.hpp"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TRANSPOSE_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Blocks are 4 x 4 pixels, which is one SSE register per row or column
+constexpr int kBlockSize = 4;
+
+// Blocks are processed in tiles of this many columns, so the column segments and row segments a
+// tile touches all stay in cache (and the TLB) until the tile is done
+constexpr int kTileWidth = 32;
+
+inline void resolvePixel(Uint32* pColumn, Uint32* pRow) {
+  if (*pColumn & 0x80000000) {
+    *pRow = *pColumn;
+  }
+  *pColumn = 0;
+}
+
+#ifdef TRANSPOSE_HAS_SSE2
+inline __m128i mergeRow(__m128i drawn, const Uint32* pRow) {
+  const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow));
+  const __m128i mask = _mm_srai_epi32(drawn, 31);
+  return _mm_or_si128(_mm_and_si128(mask, drawn), _mm_andnot_si128(mask, previous));
+}
+
+void resolveBlock(Uint32* pColumns, int height, Uint32* pRows, int rowPitch, int x, int y) {
+  __m128i* pColumn0 = reinterpret_cast<__m128i*>(pColumns + (x + 0) * height + y);
+  __m128i* pColumn1 = reinterpret_cast<__m128i*>(pColumns + (x + 1) * height + y);
+  __m128i* pColumn2 = reinterpret_cast<__m128i*>(pColumns + (x + 2) * height + y);
+  __m128i* pColumn3 = reinterpret_cast<__m128i*>(pColumns + (x + 3) * height + y);
+  const __m128i c0 = _mm_loadu_si128(pColumn0);
+  const __m128i c1 = _mm_loadu_si128(pColumn1);
+  const __m128i c2 = _mm_loadu_si128(pColumn2);
+  const __m128i c3 = _mm_loadu_si128(pColumn3);
+
+  // nothing drawn here means the block is still all zero, so there is nothing to do at all
+  const int drawnMask = _mm_movemask_ps(_mm_castsi128_ps(
+      _mm_and_si128(_mm_and_si128(c0, c1), _mm_and_si128(c2, c3))));
+  const int anyDrawnMask =
+      _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(_mm_or_si128(c0, c1), _mm_or_si128(c2, c3))));
+  if (!anyDrawnMask) {
+    return;
+  }
+
+  const __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+  const __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+  const __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+  const __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+  const __m128i rows[kBlockSize] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+                                    _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+
+  // fully drawn blocks (the common case inside walls) don't need the previous pixels
+  const bool fullyDrawn = drawnMask == 0xf;
+  for (int i = 0; i < kBlockSize; ++i) {
+    Uint32* pRow = pRows + (y + i) * rowPitch + x;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pRow),
+                     fullyDrawn ? rows[i] : mergeRow(rows[i], pRow));
+  }
+
+  const __m128i zero = _mm_setzero_si128();
+  _mm_storeu_si128(pColumn0, zero);
+  _mm_storeu_si128(pColumn1, zero);
+  _mm_storeu_si128(pColumn2, zero);
+  _mm_storeu_si128(pColumn3, zero);
+}
+#else
+void resolveBlock(Uint32* pColumns, int height, Uint32* pRows, int rowPitch, int x, int y) {
+  for (int i = 0; i < kBlockSize; ++i) {
+    for (int j = 0; j < kBlockSize; ++j) {
+      resolvePixel(pColumns + (x + j) * height + y + i, pRows + (y + i) * rowPitch + x + j);
+    }
+  }
+}
+#endif
+}  // namespace
+
+void resolveColumns(Uint32* pColumns, int width, int height, Uint32* pRows, int rowPitch,
+                    int yBegin, int yEnd) {
+  // whole blocks first
+  const int blockWidth = width - width % kBlockSize;
+  const int blockEnd = yBegin + (yEnd - yBegin) / kBlockSize * kBlockSize;
+  for (int tileX = 0; tileX < blockWidth; tileX += kTileWidth) {
+    const int tileEnd = std::min(blockWidth, tileX + kTileWidth);
+    for (int y = yBegin; y < blockEnd; y += kBlockSize) {
+      for (int x = tileX; x < tileEnd; x += kBlockSize) {
+        resolveBlock(pColumns, height, pRows, rowPitch, x, y);
+      }
+    }
+  }
+
+  // then whatever is left on the right and bottom edges
+  for (int y = yBegin; y < yEnd; ++y) {
+    const int xBegin = y < blockEnd ? blockWidth : 0;
+    for (int x = xBegin; x < width; ++x) {
+      resolvePixel(pColumns + x * height + y, pRows + y * rowPitch + x);
+    }
+  }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "sdl.hpp"
+
+// Moves the pixels of a column-major buffer into a row-major surface for rows [yBegin, yEnd).
+//
+// Pixel (x, y) of `pColumns` lives at pColumns[x * height + y]. Only pixels whose alpha bit is set
+// were drawn this frame and get copied over; all others leave the row-major pixel untouched. Every
+// pixel that was read is reset to 0, which leaves the column buffer ready for the next frame.
+void resolveColumns(Uint32* pColumns, int width, int height, Uint32* pRows, int rowPitch,
+                    int yBegin, int yEnd);
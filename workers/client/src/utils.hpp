@@ -1,8 +1,29 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 template <typename T, std::size_t N>
 constexpr std::size_t count_of(const T (&)[N]) noexcept {
   return N;
 }
+
+// Integer base 2 logarithm, exact for powers of two
+constexpr int log2i(int value) noexcept {
+  return value > 1 ? 1 + log2i(value >> 1) : 0;
+}
+
+// Index of the lowest set bit of a non-zero `value`
+inline int countTrailingZeros(std::uint64_t value) noexcept {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(value);
+#endif
+}
@@ -0,0 +1,394 @@
+#include "visibilityset.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace Eigen;
+
+namespace {
+static const char kVisibilityFileMagic[4] = {'S', '3', 'D', 'V'};
+// versions 1 and 2 were sampled per block with rays and could miss visible blocks, version 3 was
+// exact but stored per cell
+static constexpr std::uint16_t kVisibilityFileVersion = 4;
+static constexpr int kBlockSize = 1 << WorldMap::kBlockShift;
+// the cells within sprite reach of the blocks of a window, across and down
+static constexpr int kReachSize =
+    VisibilitySet::kWindowSize * kBlockSize + 2 * VisibilitySet::kSpriteReach;
+static constexpr int kReachWords = (kReachSize + 63) / 64;
+
+// Whether any of the `count` bits from bit `first` on is set, for counts up to 64
+bool anyBitSet(const std::uint64_t* pWords, int first, int count) {
+  const int shift = first & 63;
+  std::uint64_t bits = pWords[first >> 6] >> shift;
+  if (shift + count > 64) {
+    bits |= pWords[(first >> 6) + 1] << (64 - shift);
+  }
+  return count == 64 ? bits != 0 : (bits & ((std::uint64_t{1} << count) - 1)) != 0;
+}
+
+// A lattice point in the coordinates of a quadrant, where the source cell is the unit square at
+// the origin and cell (x, y) covers [x, x + 1] x [y, y + 1]
+struct Point {
+  int x;
+  int y;
+};
+
+// A line through two lattice points
+struct Line {
+  Point from;
+  Point to;
+
+  // positive if the line passes below `point`, negative if above
+  int relative(const Point& point) const {
+    return (to.y - from.y) * (to.x - point.x) - (to.x - from.x) * (to.y - point.y);
+  }
+
+  bool passesThrough(const Point& point) const {
+    return relative(point) == 0;
+  }
+
+  bool isCollinear(const Line& line) const {
+    return passesThrough(line.from) && passesThrough(line.to);
+  }
+};
+
+// Precise permissive field of view from a whole cell: a cell is visible if a line from anywhere in
+// the source cell to anywhere in it does not pass through the inside of a wall. Each quadrant is
+// swept in diagonals away from the source, keeping the views that are still open between a
+// shallow and a steep line. Walls bend the lines of the views they stick into around the corners
+// they stick out with, the bumps, and split views they stand in the middle of.
+class PermissiveFov {
+public:
+  // Calls `visit(x, y)` for every visible cell of the quadrant up to `extentX` and `extentY`,
+  // except the source itself. `isWall(x, y)` tells the cells that block the view.
+  template <typename IsWall, typename Visit>
+  void sweepQuadrant(int extentX, int extentY, const IsWall& isWall, const Visit& visit) {
+    m_views.clear();
+    m_bumps.clear();
+    m_views.push_back(View{Line{Point{0, 1}, Point{extentX, 0}},
+                           Line{Point{1, 0}, Point{0, extentY}}, -1, -1});
+
+    for (int diagonal = 1; diagonal <= extentX + extentY && !m_views.empty(); ++diagonal) {
+      std::size_t index = 0;
+      const int last = std::min(diagonal, extentY);
+      for (int j = std::max(0, diagonal - extentX); j <= last && index < m_views.size(); ++j) {
+        const int x = diagonal - j;
+        const int y = j;
+        const Point topLeft{x, y + 1};
+        const Point bottomRight{x + 1, y};
+
+        // views below the cell are done with this diagonal
+        while (index < m_views.size() && m_views[index].steep.relative(bottomRight) >= 0) {
+          ++index;
+        }
+        if (index == m_views.size()) {
+          break;
+        }
+        if (m_views[index].shallow.relative(topLeft) <= 0) {
+          // the cells below the view are not in any view
+          j = std::max(j, firstAbove(m_views[index].shallow, diagonal) - 1);
+          continue;
+        }
+
+        visit(x, y);
+        if (!isWall(x, y)) {
+          continue;
+        }
+
+        View& view = m_views[index];
+        const bool blocksShallow = view.shallow.relative(bottomRight) < 0;
+        const bool blocksSteep = view.steep.relative(topLeft) > 0;
+        if (blocksShallow && blocksSteep) {
+          m_views.erase(m_views.begin() + index);
+        } else if (blocksShallow) {
+          addShallowBump(index, topLeft);
+          checkView(index);
+        } else if (blocksSteep) {
+          addSteepBump(index, bottomRight);
+          checkView(index);
+        } else {
+          // the wall splits the view into one below and one above it
+          const View copy = view;
+          m_views.insert(m_views.begin() + index, copy);
+          std::size_t steepIndex = index + 1;
+          addSteepBump(index, bottomRight);
+          if (!checkView(index)) {
+            --steepIndex;
+          }
+          addShallowBump(steepIndex, topLeft);
+          checkView(steepIndex);
+          index = steepIndex;
+        }
+      }
+    }
+  }
+
+private:
+  // The first cell of the diagonal whose top left corner is above `line`, going up from the
+  // bottom. Saves walking the cells between views, which are most of the diagonal once only
+  // narrow views are left.
+  static int firstAbove(const Line& line, int diagonal) {
+    // the relative position of the corner grows by the same amount from each cell to the next
+    const int growth = (line.to.x - line.from.x) + (line.to.y - line.from.y);
+    if (growth <= 0) {
+      return 0;
+    }
+    const int start = (line.to.y - line.from.y) * (line.to.x - diagonal) -
+        (line.to.x - line.from.x) * (line.to.y - 1);
+    // the smallest j with start + growth * j > 0
+    return start > 0 ? 0 : -start / growth + 1;
+  }
+
+  // bumps form lists from the newest to the oldest, shared by the views split from one another
+  struct Bump {
+    Point point;
+    int parent;
+  };
+
+  struct View {
+    Line shallow;
+    Line steep;
+    int shallowBump;
+    int steepBump;
+  };
+
+  void addShallowBump(std::size_t index, const Point& point) {
+    View& view = m_views[index];
+    view.shallow.to = point;
+    m_bumps.push_back(Bump{point, view.shallowBump});
+    view.shallowBump = static_cast<int>(m_bumps.size()) - 1;
+    for (int bump = view.steepBump; bump >= 0; bump = m_bumps[bump].parent) {
+      if (view.shallow.relative(m_bumps[bump].point) < 0) {
+        view.shallow.from = m_bumps[bump].point;
+      }
+    }
+  }
+
+  void addSteepBump(std::size_t index, const Point& point) {
+    View& view = m_views[index];
+    view.steep.to = point;
+    m_bumps.push_back(Bump{point, view.steepBump});
+    view.steepBump = static_cast<int>(m_bumps.size()) - 1;
+    for (int bump = view.shallowBump; bump >= 0; bump = m_bumps[bump].parent) {
+      if (view.steep.relative(m_bumps[bump].point) > 0) {
+        view.steep.from = m_bumps[bump].point;
+      }
+    }
+  }
+
+  // Removes the view if it has closed to a line through a corner of the source, returns whether it
+  // is still open
+  bool checkView(std::size_t index) {
+    const View& view = m_views[index];
+    if (view.shallow.isCollinear(view.steep) &&
+        (view.shallow.passesThrough(Point{0, 1}) || view.shallow.passesThrough(Point{1, 0}))) {
+      m_views.erase(m_views.begin() + index);
+      return false;
+    }
+    return true;
+  }
+
+  std::vector<View> m_views;
+  std::vector<Bump> m_bumps;
+};
+}  // namespace
+
+void VisibilitySet::build(WorldMap& world) {
+  world.loadAll();
+  const int width = world.width();
+  const int height = world.height();
+  const int blocksX = (width + kBlockSize - 1) >> kBlockShift;
+  const int blocksY = (height + kBlockSize - 1) >> kBlockShift;
+  const std::size_t blockCount = static_cast<std::size_t>(blocksX) * blocksY;
+  std::vector<std::uint64_t> words(blockCount * kWordsPerBlock);
+  std::vector<std::uint8_t> sightDistances(blockCount);
+
+  ThreadPool threadPool{0};
+  threadPool.parallelFor(0, blocksY, 1, [&](int blockYBegin, int blockYEnd) {
+    PermissiveFov fov;
+    // the visible cells in reach of the window around the source, one bit each
+    std::vector<std::uint64_t> visible(kReachSize * kReachWords);
+    // whether a block of the row has an empty cell a camera can stand in
+    std::vector<bool> hasCamera(blocksX);
+    for (int blockY = blockYBegin; blockY < blockYEnd; ++blockY) {
+      std::fill(hasCamera.begin(), hasCamera.end(), false);
+      const int sourceYEnd = std::min((blockY + 1) * kBlockSize, height);
+      for (int sourceY = blockY * kBlockSize; sourceY < sourceYEnd; ++sourceY) {
+        for (int sourceX = 0; sourceX < width; ++sourceX) {
+          // a camera never stands in a wall
+          if (world.isWall(sourceX, sourceY)) {
+            continue;
+          }
+          const int blockX = sourceX >> kBlockShift;
+          const std::size_t block = static_cast<std::size_t>(blockY) * blocksX + blockX;
+          hasCamera[blockX] = true;
+
+          // the cells in reach of the window's blocks, as far as the wall around the map
+          const int reachLeft = (blockX - kRadius) * kBlockSize - kSpriteReach;
+          const int reachTop = (blockY - kRadius) * kBlockSize - kSpriteReach;
+          const int left = std::max(reachLeft, -1);
+          const int top = std::max(reachTop, -1);
+          const int right = std::min(reachLeft + kReachSize - 1, width);
+          const int bottom = std::min(reachTop + kReachSize - 1, height);
+
+          std::fill(visible.begin(), visible.end(), 0);
+          const auto mark = [&](int x, int y) {
+            const int bit = x - reachLeft;
+            visible[(y - reachTop) * kReachWords + (bit >> 6)] |= std::uint64_t{1} << (bit & 63);
+          };
+          mark(sourceX, sourceY);
+          // the source sees itself
+          int farthest = 2;
+          bool leavesWindow = false;
+
+          for (const Vector2i& quadrant : {Vector2i{1, 1}, Vector2i{-1, 1}, Vector2i{-1, -1},
+                                          Vector2i{1, -1}}) {
+            const int extentX = quadrant.x() > 0 ? right - sourceX : sourceX - left;
+            const int extentY = quadrant.y() > 0 ? bottom - sourceY : sourceY - top;
+            fov.sweepQuadrant(
+                extentX, extentY,
+                [&](int x, int y) {
+                  return world.isWall(sourceX + quadrant.x() * x, sourceY + quadrant.y() * y);
+                },
+                [&](int x, int y) {
+                  const int cellX = sourceX + quadrant.x() * x;
+                  const int cellY = sourceY + quadrant.y() * y;
+                  mark(cellX, cellY);
+                  // the far corner of the cell from the far corner of the source
+                  farthest = std::max(farthest, (x + 1) * (x + 1) + (y + 1) * (y + 1));
+                  // sightlines through an empty cell on the edge may go on past the window
+                  if ((x == extentX || y == extentY) && !world.isWall(cellX, cellY)) {
+                    leavesWindow = true;
+                  }
+                });
+          }
+
+          // a block may show a sprite if any cell within reach of it is visible from any cell of
+          // the camera's block
+          std::uint64_t* pWords = &words[block * kWordsPerBlock];
+          for (int windowY = 0; windowY < kWindowSize; ++windowY) {
+            std::uint64_t rows[kReachWords] = {};
+            for (int row = windowY * kBlockSize;
+                 row < (windowY + 1) * kBlockSize + 2 * kSpriteReach; ++row) {
+              for (int word = 0; word < kReachWords; ++word) {
+                rows[word] |= visible[row * kReachWords + word];
+              }
+            }
+            for (int windowX = 0; windowX < kWindowSize; ++windowX) {
+              if (anyBitSet(rows, windowX * kBlockSize, kBlockSize + 2 * kSpriteReach)) {
+                const int bit = windowY * kWindowSize + windowX;
+                pWords[bit >> 6] |= std::uint64_t{1} << (bit & 63);
+              }
+            }
+          }
+
+          // kFarSight is above every distance that fits into the window
+          const std::uint8_t distance = leavesWindow
+              ? kFarSight
+              : static_cast<std::uint8_t>(std::ceil(std::sqrt(static_cast<double>(farthest))));
+          sightDistances[block] = std::max(sightDistances[block], distance);
+        }
+      }
+
+      // solid blocks are never looked up, but stay safe if they are
+      for (int blockX = 0; blockX < blocksX; ++blockX) {
+        if (!hasCamera[blockX]) {
+          const std::size_t block = static_cast<std::size_t>(blockY) * blocksX + blockX;
+          std::fill(&words[block * kWordsPerBlock], &words[(block + 1) * kWordsPerBlock],
+                    ~std::uint64_t{0});
+          sightDistances[block] = kFarSight;
+        }
+      }
+    }
+  });
+
+  m_pFile.reset();
+  m_width = width;
+  m_height = height;
+  m_blocksX = blocksX;
+  m_words = std::move(words);
+  m_sightDistances = std::move(sightDistances);
+  m_pWords = m_words.data();
+  m_pSightDistances = m_sightDistances.data();
+}
+
+bool VisibilitySet::load(const std::string& filename, const WorldMap& world) {
+  std::unique_ptr<MappedFile> pFile{new MappedFile};
+  if (!pFile->open(filename)) {
+    return false;
+  }
+
+  VisibilityFileHeader header;
+  if (pFile->size() < sizeof(header)) {
+    std::cout << "Invalid visibility file '" << filename << "': too small" << std::endl;
+    return false;
+  }
+  std::memcpy(&header, pFile->data(), sizeof(header));
+  if (std::memcmp(header.magic, kVisibilityFileMagic, sizeof(kVisibilityFileMagic)) != 0 ||
+      header.version != kVisibilityFileVersion || header.radius != kRadius ||
+      header.spriteReach != kSpriteReach) {
+    std::cout << "Invalid visibility file '" << filename << "': unknown format" << std::endl;
+    return false;
+  }
+  if (header.width != static_cast<std::uint32_t>(world.width()) ||
+      header.height != static_cast<std::uint32_t>(world.height())) {
+    std::cout << "Invalid visibility file '" << filename << "': made for a different map"
+              << std::endl;
+    return false;
+  }
+
+  const int blocksX = (world.width() + kBlockSize - 1) >> kBlockShift;
+  const int blocksY = (world.height() + kBlockSize - 1) >> kBlockShift;
+  const std::size_t blockCount = static_cast<std::size_t>(blocksX) * blocksY;
+  const std::size_t wordBytes = blockCount * kWordsPerBlock * sizeof(std::uint64_t);
+  if (pFile->size() < sizeof(header) + wordBytes + blockCount) {
+    std::cout << "Invalid visibility file '" << filename << "': truncated" << std::endl;
+    return false;
+  }
+
+  // the header keeps the words 8 byte aligned in the page aligned mapping
+  static_assert(sizeof(VisibilityFileHeader) % sizeof(std::uint64_t) == 0,
+                "visibility words must stay aligned");
+  const std::uint8_t* pData = pFile->data() + sizeof(header);
+  m_pFile = std::move(pFile);
+  m_words.clear();
+  m_words.shrink_to_fit();
+  m_sightDistances.clear();
+  m_sightDistances.shrink_to_fit();
+  m_width = world.width();
+  m_height = world.height();
+  m_blocksX = blocksX;
+  m_pWords = reinterpret_cast<const std::uint64_t*>(pData);
+  m_pSightDistances = pData + wordBytes;
+  return true;
+}
+
+bool VisibilitySet::save(const std::string& filename) const {
+  VisibilityFileHeader header;
+  std::memcpy(header.magic, kVisibilityFileMagic, sizeof(kVisibilityFileMagic));
+  header.version = kVisibilityFileVersion;
+  header.radius = kRadius;
+  header.spriteReach = kSpriteReach;
+  header.width = static_cast<std::uint32_t>(m_width);
+  header.height = static_cast<std::uint32_t>(m_height);
+
+  const int blocksY = (m_height + kBlockSize - 1) >> kBlockShift;
+  const std::size_t blockCount = static_cast<std::size_t>(m_blocksX) * blocksY;
+  std::ofstream file{filename, std::ios::binary};
+  if (!file) {
+    std::cout << "Could not open '" << filename << "' for writing" << std::endl;
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(m_pWords),
+             blockCount * kWordsPerBlock * sizeof(std::uint64_t));
+  file.write(reinterpret_cast<const char*>(m_pSightDistances), blockCount);
+  if (!file) {
+    std::cout << "Could not write visibility set '" << filename << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
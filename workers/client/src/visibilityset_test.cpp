@@ -0,0 +1,155 @@
+// Casts sightlines from random points of the empty cells of generated maps and checks that the
+// visibility set of each map rules out no sprite that reaches over one of them before it ends in a
+// wall. Exits with a non-zero status on the first sprite that is culled but could be seen.
+
+#include "raycast.hpp"
+#include "visibilityset.hpp"
+#include "worldmap.hpp"
+#include <Eigen/Dense>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Eigen;
+
+namespace {
+static constexpr unsigned int kSeed = 1;
+// two by two sets of blocks and the window around them
+static constexpr int kMapSize = 160;
+static const int kFillPercents[] = {10, 30, 45};
+static constexpr int kSightlines = 20000;
+static constexpr double kStep = 0.1;
+static constexpr double kDrawDistance = 64;
+// a 4:3 screen, wider screens draw narrower sprites
+static constexpr double kSpriteRadius = 1.25;
+static constexpr int kSpriteDirections = 8;
+static constexpr double kPi = 3.14159265358979323846;
+
+bool writeMap(const std::string& filename, int fillPercent, std::mt19937& random) {
+  std::vector<std::uint16_t> cells(kMapSize * kMapSize);
+  std::uniform_int_distribution<int> percent{0, 99};
+  for (int y = 0; y < kMapSize; ++y) {
+    for (int x = 0; x < kMapSize; ++x) {
+      const bool edge = x == 0 || y == 0 || x == kMapSize - 1 || y == kMapSize - 1;
+      cells[y * kMapSize + x] = edge || percent(random) < fillPercent;
+    }
+  }
+  return writeMapFile(filename, kMapSize, kMapSize, cells);
+}
+
+// Whether the set keeps every sprite that reaches within its radius of a sightline from `pos` in
+// direction `dir`, up to the wall the sightline ends in
+bool checkSightline(const WorldMap& world, const VisibilitySet& visibility, const Vector2d& pos,
+                    const Vector2d& dir) {
+  const Vector2i cell = pos.cast<int>();
+  const WallHit hit = castRay(world, pos, setupRay(dir), 1, 1);
+  const double length = std::min(hit.perpWallDist, kDrawDistance);
+  for (double t = 0; t <= length; t += kStep) {
+    const Vector2d seen = pos + dir * t;
+    for (int i = 0; i <= kSpriteDirections; ++i) {
+      // the sprite stands right there or as far to the side as it is drawn
+      const double angle = 2 * kPi * i / kSpriteDirections;
+      const double offset = i == kSpriteDirections ? 0 : kSpriteRadius;
+      const Vector2d sprite = seen + Vector2d{std::cos(angle), std::sin(angle)} * offset;
+      const Vector2i spriteCell{static_cast<int>(std::floor(sprite.x())),
+                                static_cast<int>(std::floor(sprite.y()))};
+      if (!visibility.isPotentiallyVisible(cell, spriteCell) ||
+          (sprite - pos).norm() > visibility.sightDistance(cell) + kSpriteRadius) {
+        std::cout << "A sprite at (" << sprite.x() << ", " << sprite.y() << ") is culled, but "
+                  << "reaches over the sightline from (" << pos.x() << ", " << pos.y()
+                  << ") at distance " << t << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The share of the blocks in reach of the window around empty cells that the set rules out
+double culledShare(const WorldMap& world, const VisibilitySet& visibility) {
+  const int blockSize = 1 << WorldMap::kBlockShift;
+  const int blocks = kMapSize / blockSize;
+  std::int64_t culled = 0;
+  std::int64_t total = 0;
+  for (int y = 0; y < kMapSize; ++y) {
+    for (int x = 0; x < kMapSize; ++x) {
+      if (!world.isEmpty(Vector2i{x, y})) {
+        continue;
+      }
+      for (int blockY = 0; blockY < blocks; ++blockY) {
+        for (int blockX = 0; blockX < blocks; ++blockX) {
+          const Vector2i blockCorner{blockX * blockSize, blockY * blockSize};
+          if ((blockCorner - Vector2i{x, y}).cwiseAbs().maxCoeff() > kDrawDistance) {
+            continue;
+          }
+          culled += !visibility.isPotentiallyVisible(Vector2i{x, y}, blockCorner);
+          ++total;
+        }
+      }
+    }
+  }
+  return static_cast<double>(culled) / total;
+}
+
+bool testMap(int fillPercent, std::mt19937& random) {
+  const char* pTempDir = std::getenv("TEST_TMPDIR");
+  const std::string filename =
+      std::string{pTempDir ? pTempDir : "."} + "/visibilityset_test.map";
+  WorldMap world;
+  const bool loaded = writeMap(filename, fillPercent, random) && world.load(filename);
+  std::remove(filename.c_str());
+  if (!loaded) {
+    return false;
+  }
+
+  // the sightlines are checked against the set as it is read back from its file
+  const std::string visibilityFilename = filename + ".pvs";
+  VisibilitySet built;
+  VisibilitySet visibility;
+  built.build(world);
+  const bool reloaded =
+      built.save(visibilityFilename) && visibility.load(visibilityFilename, world);
+  std::remove(visibilityFilename.c_str());
+  if (!reloaded) {
+    return false;
+  }
+  if (!visibility.culls(kSpriteRadius)) {
+    std::cout << "The set does not cull sprites of radius " << kSpriteRadius << std::endl;
+    return false;
+  }
+
+  std::uniform_real_distribution<double> coordinate{0, kMapSize};
+  std::uniform_real_distribution<double> angle{0, 2 * kPi};
+  for (int i = 0; i < kSightlines;) {
+    const Vector2d pos{coordinate(random), coordinate(random)};
+    if (!world.isEmpty(pos.cast<int>())) {
+      continue;
+    }
+    const double a = angle(random);
+    if (!checkSightline(world, visibility, pos, Vector2d{std::cos(a), std::sin(a)})) {
+      return false;
+    }
+    ++i;
+  }
+
+  std::cout << fillPercent << "% walls: " << kSightlines << " sightlines are in the set, "
+            << static_cast<int>(100 * culledShare(world, visibility) + 0.5)
+            << "% of the blocks in range are culled" << std::endl;
+  return true;
+}
+}  // namespace
+
+int main() {
+  std::mt19937 random{kSeed};
+  for (int fillPercent : kFillPercents) {
+    if (!testMap(fillPercent, random)) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
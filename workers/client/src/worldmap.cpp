@@ -1,7 +1,28 @@
 #include "worldmap.hpp"
-#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
 
-const int WorldMap::m_map[WorldMap::kMapWidth][WorldMap::kMapHeight] = {
+namespace {
+static const char kMapFileMagic[4] = {'S', '3', 'D', 'M'};
+static constexpr std::uint16_t kMapFileVersion = 1;
+
+// Chunks within this many chunks of the player are kept loaded, the nearest ones synchronously
+static constexpr int kPrefetchRadius = 4;
+static constexpr int kLoadNowRadius = 1;
+// Maximum number of chunks in memory, at 4 or 8 KB each
+static constexpr std::size_t kChunkCacheCapacity = 256;
+static_assert(kChunkCacheCapacity >= (2 * kPrefetchRadius + 1) * (2 * kPrefetchRadius + 1),
+              "the cache has to fit all chunks around the player");
+// Rays only leap over the empty blocks of chunks with at most this many of 64 blocks with walls
+static constexpr int kMaxLeapChunkWallBlocks = 16;
+static constexpr int kBuiltinMapWidth = 24;
+static constexpr int kBuiltinMapHeight = 24;
+
+// indexed [x][y]
+static const std::uint8_t kBuiltinMap[kBuiltinMapWidth][kBuiltinMapHeight] = {
     {8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 4, 4, 6, 4, 4, 6, 4, 6, 4, 4, 4, 6, 4},
     {8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4},
     {8, 0, 3, 3, 0, 0, 0, 0, 0, 8, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6},
@@ -26,17 +47,300 @@ const int WorldMap::m_map[WorldMap::kMapWidth][WorldMap::kMapHeight] = {
     {2, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 2, 5, 0, 5, 0, 5, 0, 5, 0, 5},
     {2, 2, 0, 0, 0, 0, 0, 2, 2, 2, 0, 0, 0, 2, 2, 0, 5, 0, 5, 0, 0, 0, 5, 5},
     {2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 5, 5, 5, 5, 5, 5, 5, 5, 5}};
+}  // namespace
 
-int WorldMap::at(const Eigen::Vector2i& pos) const {
-  return at(pos.x(), pos.y());
+WorldMap::WorldMap() {
+  m_builtinCells.resize(kBuiltinMapWidth * kBuiltinMapHeight);
+  for (int y = 0; y < kBuiltinMapHeight; ++y) {
+    for (int x = 0; x < kBuiltinMapWidth; ++x) {
+      m_builtinCells[y * kBuiltinMapWidth + x] = kBuiltinMap[x][y];
+    }
+  }
+  reset(kBuiltinMapWidth, kBuiltinMapHeight, 1, m_builtinCells.data());
 }
 
-int WorldMap::at(int x, int y) const {
-  x = std::min(x, kMapWidth - 1);
-  y = std::min(y, kMapHeight - 1);
-  return m_map[x][y];
+WorldMap::~WorldMap() {
+  // the loader reads from the map source until it stops
+  m_pLoader.reset();
+}
+
+bool WorldMap::load(const std::string& filename) {
+  std::unique_ptr<MappedFile> pFile{new MappedFile};
+  if (!pFile->open(filename)) {
+    return false;
+  }
+
+  MapFileHeader header;
+  if (pFile->size() < sizeof(header)) {
+    std::cout << "Invalid map file '" << filename << "': too small" << std::endl;
+    return false;
+  }
+  std::memcpy(&header, pFile->data(), sizeof(header));
+  if (std::memcmp(header.magic, kMapFileMagic, sizeof(kMapFileMagic)) != 0 ||
+      header.version != kMapFileVersion) {
+    std::cout << "Invalid map file '" << filename << "': unknown format" << std::endl;
+    return false;
+  }
+  if ((header.cellSize != 1 && header.cellSize != 2) || header.width == 0 || header.height == 0 ||
+      header.width > kMaxMapSize || header.height > kMaxMapSize) {
+    std::cout << "Invalid map file '" << filename << "': " << header.width << "x" << header.height
+              << " map with " << header.cellSize << " byte cells" << std::endl;
+    return false;
+  }
+  const std::size_t cellBytes =
+      static_cast<std::size_t>(header.width) * header.height * header.cellSize;
+  if (pFile->size() < sizeof(header) + cellBytes) {
+    std::cout << "Invalid map file '" << filename << "': truncated" << std::endl;
+    return false;
+  }
+
+  const std::uint8_t* pCells = pFile->data() + sizeof(header);
+  const int width = static_cast<int>(header.width);
+  const int height = static_cast<int>(header.height);
+  m_pLoader.reset();
+  m_pFile = std::move(pFile);
+  m_builtinCells.clear();
+  m_builtinCells.shrink_to_fit();
+  reset(width, height, header.cellSize, pCells);
+  return true;
+}
+
+void WorldMap::reset(int width, int height, int cellSize, const std::uint8_t* pSource) {
+  m_pLoader.reset();
+  m_pSource = pSource;
+  m_cellSize = cellSize;
+  m_width = width;
+  m_height = height;
+  m_chunksX = (width + kChunkMask) >> kChunkShift;
+  m_chunksY = (height + kChunkMask) >> kChunkShift;
+
+  m_chunkPitch = m_chunksX + 2;
+
+  const std::size_t chunkCount = static_cast<std::size_t>(m_chunksX) * m_chunksY;
+  const std::size_t slotCount = static_cast<std::size_t>(m_chunkPitch) * (m_chunksY + 2);
+  m_solidChunk.resize(kChunkSize * kChunkSize * cellSize);
+  for (int i = 0; i < kChunkSize * kChunkSize; ++i) {
+    if (cellSize == 1) {
+      m_solidChunk[i] = static_cast<std::uint8_t>(kSolidCell);
+    } else {
+      reinterpret_cast<std::uint16_t*>(m_solidChunk.data())[i] = kSolidCell;
+    }
+  }
+  m_chunkCells.assign(slotCount, m_solidChunk.data());
+  m_blockMasks.assign(slotCount, ~std::uint64_t{0});
+  m_leapChunkCount = 0;
+  m_occupancy.assign(static_cast<std::size_t>(height + 2) * m_chunkPitch, ~std::uint64_t{0});
+  m_chunks.clear();
+  m_chunks.resize(chunkCount);
+  m_residentChunks.clear();
+
+  // small maps are loaded completely and never stream
+  if (chunkCount <= kChunkCacheCapacity) {
+    loadAll();
+  }
 }
 
-bool WorldMap::isEmpty(const Eigen::Vector2i& pos) const {
-  return at(pos) == 0;
+bool WorldMap::update(const Eigen::Vector2d& pos) {
+  ++m_updateCount;
+  bool changed = false;
+
+  if (m_pLoader) {
+    m_loadedChunks.clear();
+    m_pLoader->collect(m_loadedChunks);
+    for (ChunkLoader::LoadedChunk& chunk : m_loadedChunks) {
+      if (!m_chunks[chunk.index]) {
+        publishChunk(chunk.index, std::move(chunk.cells));
+        changed = true;
+      }
+    }
+  }
+  if (m_residentChunks.size() == m_chunks.size()) {
+    return changed;
+  }
+
+  const int centerX = std::min(std::max(static_cast<int>(pos.x()), 0), m_width - 1) >> kChunkShift;
+  const int centerY = std::min(std::max(static_cast<int>(pos.y()), 0), m_height - 1) >> kChunkShift;
+
+  // walk the rings of chunks around the player from the inside out, so the nearest load first
+  m_requests.clear();
+  for (int ring = 0; ring <= kPrefetchRadius; ++ring) {
+    for (int chunkY = centerY - ring; chunkY <= centerY + ring; ++chunkY) {
+      for (int chunkX = centerX - ring; chunkX <= centerX + ring; ++chunkX) {
+        if (std::max(std::abs(chunkX - centerX), std::abs(chunkY - centerY)) != ring ||
+            chunkX < 0 || chunkY < 0 || chunkX >= m_chunksX || chunkY >= m_chunksY) {
+          continue;
+        }
+
+        const int index = chunkY * m_chunksX + chunkX;
+        if (m_chunks[index]) {
+          m_chunks[index]->lastUsed = m_updateCount;
+        } else if (ring <= kLoadNowRadius) {
+          // the player could walk or look into these before a background load finishes
+          std::vector<std::uint8_t> cells;
+          loadChunk(index, cells);
+          publishChunk(index, std::move(cells));
+          changed = true;
+        } else {
+          m_requests.push_back(index);
+        }
+      }
+    }
+  }
+
+  if (!m_requests.empty() && !m_pLoader) {
+    m_pLoader.reset(new ChunkLoader([this](int chunkIndex, std::vector<std::uint8_t>& cells) {
+      loadChunk(chunkIndex, cells);
+    }));
+  }
+  if (m_pLoader) {
+    m_pLoader->setRequests(m_requests);
+  }
+
+  if (evictChunks()) {
+    changed = true;
+  }
+  return changed;
+}
+
+void WorldMap::loadAll() {
+  m_pLoader.reset();
+  for (int index = 0; index < static_cast<int>(m_chunks.size()); ++index) {
+    if (!m_chunks[index]) {
+      std::vector<std::uint8_t> cells;
+      loadChunk(index, cells);
+      publishChunk(index, std::move(cells));
+    }
+  }
+}
+
+void WorldMap::loadChunk(int chunkIndex, std::vector<std::uint8_t>& cells) const {
+  // only reads state that stays constant while the loader runs
+  const int chunkX = chunkIndex % m_chunksX;
+  const int chunkY = chunkIndex / m_chunksX;
+  const int x = chunkX << kChunkShift;
+  const int y = chunkY << kChunkShift;
+  const int columns = std::min(kChunkSize, m_width - x);
+  const int rows = std::min(kChunkSize, m_height - y);
+
+  // cells past the edge of the map can never be reached and count as walls
+  cells = m_solidChunk;
+  for (int row = 0; row < rows; ++row) {
+    const std::size_t sourceIndex = static_cast<std::size_t>(y + row) * m_width + x;
+    std::memcpy(cells.data() + (row << kChunkShift) * m_cellSize,
+                m_pSource + sourceIndex * m_cellSize, columns * m_cellSize);
+  }
+}
+
+void WorldMap::publishChunk(int chunkIndex, std::vector<std::uint8_t>&& cells) {
+  std::unique_ptr<Chunk> pChunk{new Chunk};
+  pChunk->cells = std::move(cells);
+  pChunk->lastUsed = m_updateCount;
+  const int slot = chunkSlot(chunkIndex);
+  m_chunkCells[slot] = pChunk->cells.data();
+
+  const int chunkX = (chunkIndex % m_chunksX) << kChunkShift;
+  const int chunkY = (chunkIndex / m_chunksX) << kChunkShift;
+  const int rows = std::min(kChunkSize, m_height - chunkY);
+  std::uint64_t blockRows[kChunkSize >> kBlockShift] = {};
+  for (int y = 0; y < kChunkSize; ++y) {
+    std::uint64_t word = 0;
+    for (int x = 0; x < kChunkSize; ++x) {
+      const int index = (y << kChunkShift) + x;
+      const int cell = m_cellSize == 1
+          ? pChunk->cells[index]
+          : reinterpret_cast<const std::uint16_t*>(pChunk->cells.data())[index];
+      word |= static_cast<std::uint64_t>(cell != 0) << x;
+    }
+    // rows past the edge of the map are covered by the border
+    if (y < rows) {
+      occupancyWord(chunkX, chunkY + y) = word;
+    }
+    blockRows[y >> kBlockShift] |= word;
+  }
+
+  // a block has a wall if any of its rows does
+  const std::uint64_t blockRowBits = (std::uint64_t{1} << (1 << kBlockShift)) - 1;
+  std::uint64_t blockMask = 0;
+  for (int blockY = 0; blockY < (kChunkSize >> kBlockShift); ++blockY) {
+    for (int blockX = 0; blockX < (kChunkSize >> kBlockShift); ++blockX) {
+      const std::uint64_t blockBits = (blockRows[blockY] >> (blockX << kBlockShift)) & blockRowBits;
+      if (blockBits) {
+        blockMask |= std::uint64_t{1} << ((blockY << (kChunkShift - kBlockShift)) + blockX);
+      }
+    }
+  }
+  // leaping in and out of scattered empty blocks is slower than stepping through them
+  const bool leap =
+      static_cast<int>(std::bitset<64>(blockMask).count()) <= kMaxLeapChunkWallBlocks;
+  m_blockMasks[slot] = leap ? blockMask : ~std::uint64_t{0};
+  m_leapChunkCount += leap;
+  m_chunks[chunkIndex] = std::move(pChunk);
+  m_residentChunks.push_back(chunkIndex);
+}
+
+void WorldMap::clearChunkOccupancy(int chunkIndex) {
+  const int chunkX = (chunkIndex % m_chunksX) << kChunkShift;
+  const int chunkY = (chunkIndex / m_chunksX) << kChunkShift;
+  const int rows = std::min(kChunkSize, m_height - chunkY);
+  for (int y = 0; y < rows; ++y) {
+    occupancyWord(chunkX, chunkY + y) = ~std::uint64_t{0};
+  }
+}
+
+bool WorldMap::evictChunks() {
+  if (m_residentChunks.size() <= kChunkCacheCapacity) {
+    return false;
+  }
+
+  // drop the least recently used chunks, which are never the ones around the player
+  const std::size_t evictCount = m_residentChunks.size() - kChunkCacheCapacity;
+  std::nth_element(m_residentChunks.begin(), m_residentChunks.begin() + evictCount,
+                   m_residentChunks.end(), [this](int lhs, int rhs) {
+                     return m_chunks[lhs]->lastUsed < m_chunks[rhs]->lastUsed;
+                   });
+  for (std::size_t i = 0; i < evictCount; ++i) {
+    const int index = m_residentChunks[i];
+    m_chunkCells[chunkSlot(index)] = m_solidChunk.data();
+    m_leapChunkCount -= !!~m_blockMasks[chunkSlot(index)];
+    m_blockMasks[chunkSlot(index)] = ~std::uint64_t{0};
+    clearChunkOccupancy(index);
+    m_chunks[index].reset();
+  }
+  m_residentChunks.erase(m_residentChunks.begin(), m_residentChunks.begin() + evictCount);
+  return true;
+}
+
+bool writeMapFile(const std::string& filename, int width, int height,
+                  const std::vector<std::uint16_t>& cells) {
+  if (width <= 0 || height <= 0 || width > WorldMap::kMaxMapSize ||
+      height > WorldMap::kMaxMapSize ||
+      cells.size() != static_cast<std::size_t>(width) * height) {
+    std::cout << "Could not write map '" << filename << "': invalid size" << std::endl;
+    return false;
+  }
+
+  MapFileHeader header;
+  std::memcpy(header.magic, kMapFileMagic, sizeof(kMapFileMagic));
+  header.version = kMapFileVersion;
+  header.cellSize = *std::max_element(cells.begin(), cells.end()) > 0xff ? 2 : 1;
+  header.width = static_cast<std::uint32_t>(width);
+  header.height = static_cast<std::uint32_t>(height);
+
+  std::ofstream file{filename, std::ios::binary};
+  if (!file) {
+    std::cout << "Could not open '" << filename << "' for writing" << std::endl;
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (header.cellSize == 1) {
+    std::vector<std::uint8_t> bytes(cells.begin(), cells.end());
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  } else {
+    file.write(reinterpret_cast<const char*>(cells.data()), cells.size() * sizeof(cells[0]));
+  }
+  if (!file) {
+    std::cout << "Could not write map '" << filename << "'" << std::endl;
+    return false;
+  }
+  return true;
 }